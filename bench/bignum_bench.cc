@@ -0,0 +1,147 @@
+#include "bigint.hh"
+#include "interp.hh"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#ifdef ESQUEMA_HAVE_GMP
+#include <gmp.h>
+#endif
+
+namespace {
+    using namespace std::literals::string_view_literals;
+    using namespace std::literals::string_literals;
+    using namespace esquema;
+
+    // Returns the best time in seconds so the GMP numbers can be
+    // set against ours
+    template <typename Fn>
+    double run(std::string_view name, Fn fn) {
+        auto best = 1e300;
+        for (auto run = 0; run < 5; ++run) {
+            auto start = std::chrono::steady_clock::now();
+            fn();
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            if (elapsed.count() < best) {
+                best = elapsed.count();
+            }
+        }
+
+        std::cout << name << ": best of 5: "sv << best * 1e3 << " ms\n"sv;
+        return best;
+    }
+
+    BigInt factorial(std::int64_t n) {
+        auto acc = BigInt{1};
+        for (auto i = std::int64_t{2}; i <= n; ++i) {
+            acc = acc * BigInt{i};
+        }
+
+        return acc;
+    }
+
+    BigInt fibonacci(std::int64_t n) {
+        auto a = BigInt{0};
+        auto b = BigInt{1};
+        for (auto i = std::int64_t{0}; i < n; ++i) {
+            a = a + b;
+            std::swap(a, b);
+        }
+
+        return a;
+    }
+
+    // Both about the same size, which is where Karatsuba earns its keep
+    BigInt square(BigInt const & num, int times) {
+        auto acc = num;
+        for (auto i = 0; i < times; ++i) {
+            acc = acc * acc;
+        }
+
+        return acc;
+    }
+
+#ifdef ESQUEMA_HAVE_GMP
+    void compare(std::string_view name, double ours, double gmp) {
+        std::cout << name << ": "sv << ours / gmp << "x GMP\n"sv;
+    }
+#endif
+}
+
+// Usage: bignum_bench [n]
+int main(int argc, char ** argv) {
+    auto const n = static_cast<std::int64_t>(argc > 1 ? std::atoi(argv[1]) : 5000);
+    auto const count = std::to_string(n);
+    auto const defs =
+        "(define fact (lambda (n acc) (if (< n 2) acc (fact (+ n -1) (* n acc)))))"
+        "(define fib (lambda (n a b) (if (< n 1) a (fib (+ n -1) b (+ a b)))))"s;
+
+    Interpreter vm{Interpreter::Engine::Bytecode};
+    vm.eval_all(defs);
+
+    // The whole interpreter, calls and the collector included
+    run("vm, factorial"sv, [&] { vm.eval("(fact "s + count + " 1)"s); });
+    run("vm, fibonacci"sv, [&] { vm.eval("(fib "s + std::to_string(10 * n) + " 0 1)"s); });
+
+    // Just the arithmetic
+    auto const seed = factorial(n);
+    auto fact = run("factorial"sv, [&] { factorial(n); });
+    auto fib = run("fibonacci"sv, [&] { fibonacci(10 * n); });
+    auto sq = run("repeated squaring"sv, [&] { square(seed, 4); });
+    auto str = run("to_string"sv, [&] { seed.to_string(); });
+
+#ifdef ESQUEMA_HAVE_GMP
+    mpz_t gmp_seed;
+    mpz_init(gmp_seed);
+    mpz_set_str(gmp_seed, seed.to_string().c_str(), 10);
+
+    auto gmp_fact = run("gmp, factorial"sv, [&] {
+        mpz_t acc;
+        mpz_init_set_ui(acc, 1);
+        for (auto i = std::int64_t{2}; i <= n; ++i) {
+            mpz_mul_ui(acc, acc, static_cast<unsigned long>(i));
+        }
+        mpz_clear(acc);
+    });
+
+    auto gmp_fib = run("gmp, fibonacci"sv, [&] {
+        mpz_t a, b;
+        mpz_init_set_ui(a, 0);
+        mpz_init_set_ui(b, 1);
+        for (auto i = std::int64_t{0}; i < 10 * n; ++i) {
+            mpz_add(a, a, b);
+            mpz_swap(a, b);
+        }
+        mpz_clear(a);
+        mpz_clear(b);
+    });
+
+    auto gmp_sq = run("gmp, repeated squaring"sv, [&] {
+        mpz_t acc;
+        mpz_init_set(acc, gmp_seed);
+        for (auto i = 0; i < 4; ++i) {
+            mpz_mul(acc, acc, acc);
+        }
+        mpz_clear(acc);
+    });
+
+    auto gmp_str = run("gmp, to_string"sv, [&] {
+        auto txt = mpz_get_str(nullptr, 10, gmp_seed);
+        std::free(txt);
+    });
+    mpz_clear(gmp_seed);
+
+    compare("factorial"sv, fact, gmp_fact);
+    compare("fibonacci"sv, fib, gmp_fib);
+    compare("repeated squaring"sv, sq, gmp_sq);
+    compare("to_string"sv, str, gmp_str);
+#else
+    static_cast<void>(fact);
+    static_cast<void>(fib);
+    static_cast<void>(sq);
+    static_cast<void>(str);
+#endif
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,49 @@
+#include "interp.hh"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+namespace {
+    using namespace std::literals::string_view_literals;
+    using namespace std::literals::string_literals;
+    using namespace esquema;
+
+    void run(std::string_view name, Interpreter & interp, std::string const & src, double iterations) {
+        auto best = 1e300;
+        for (auto run = 0; run < 5; ++run) {
+            auto start = std::chrono::steady_clock::now();
+            interp.eval(src);
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            if (elapsed.count() < best) {
+                best = elapsed.count();
+            }
+        }
+
+        std::cout << name << ": best of 5: "sv << best * 1e9 / iterations << " ns/call\n"sv;
+    }
+}
+
+// Usage: call_bench [iterations]
+int main(int argc, char ** argv) {
+    auto const n = argc > 1 ? std::atoi(argv[1]) : 1'000'000;
+    auto const count = std::to_string(n);
+    auto const defs =
+        "(define loop (lambda (n acc) (if (< n 1) acc (loop (+ n -1) (+ acc n)))))"
+        "(define count (lambda (n) (if (< n 1) 0 (+ 1 (count (+ n -1))))))"
+        "(define step (lambda (n) (define next (+ n -1)) (if (< next 1) 0 (step next))))"s;
+
+    Interpreter vm{Interpreter::Engine::Bytecode};
+    Interpreter walker{Interpreter::Engine::TreeWalker};
+    vm.eval_all(defs);
+    walker.eval_all(defs);
+
+    // The tree walker still recurses in C++ for calls that aren't
+    // tail calls so it sits the count out
+    run("vm, tail call loop"sv, vm, "(loop "s + count + " 0)"s, n);
+    run("vm, tail call loop with a scope"sv, vm, "(step "s + count + ")"s, n);
+    run("vm, non tail recursion"sv, vm, "(count "s + count + ")"s, n);
+    run("tree walker, tail call loop"sv, walker, "(loop "s + count + " 0)"s, n);
+    run("tree walker, tail call loop with a scope"sv, walker, "(step "s + count + ")"s, n);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,114 @@
+#include "environ.hh"
+#include "interp.hh"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+    using namespace std::literals::string_view_literals;
+    using namespace std::literals::string_literals;
+    using namespace esquema;
+
+    template <typename Fn>
+    void run(std::string_view name, std::size_t ops, Fn fn) {
+        auto best = 1e300;
+        for (auto run = 0; run < 5; ++run) {
+            auto start = std::chrono::steady_clock::now();
+            fn();
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            if (elapsed.count() < best) {
+                best = elapsed.count();
+            }
+        }
+
+        std::cout << name << ": best of 5: "sv
+                  << best * 1e9 / static_cast<double>(ops) << " ns/op\n"sv;
+    }
+}
+
+// Usage: env_bench [globals]
+int main(int argc, char ** argv) {
+    auto const globals = static_cast<std::size_t>(argc > 1 ? std::atoi(argv[1]) : 10000);
+    std::vector<Symbol> symbols{};
+    for (auto i = std::size_t{0}; i < globals; ++i) {
+        symbols.emplace_back("global-variable-"s + std::to_string(i));
+    }
+
+    // A lookup pattern with no locality to it
+    auto rng = std::mt19937{42};
+    std::vector<Symbol> lookups{};
+    for (auto i = 0; i < 1'000'000; ++i) {
+        lookups.push_back(symbols[std::uniform_int_distribution<std::size_t>{0, globals - 1}(rng)]);
+    }
+
+    auto volatile sink = std::size_t{0};
+    run("make_global"sv, 100'000, [&] {
+        for (auto i = 0; i < 100'000; ++i) {
+            auto env = Environment::make_global();
+            sink = sink + static_cast<std::size_t>(env.id());
+        }
+    });
+
+    run("Interpreter construction"sv, 100'000, [&] {
+        for (auto i = 0; i < 100'000; ++i) {
+            Interpreter interp{};
+            sink = sink + static_cast<std::size_t>(interp.engine() == Interpreter::Engine::Bytecode);
+        }
+    });
+
+    run("insert"sv, globals, [&] {
+        auto env = Environment::make_global();
+        for (auto const & sym : symbols) {
+            env.insert(sym, Number{1});
+        }
+
+        sink = sink + static_cast<std::size_t>(env.begin() != env.end());
+    });
+
+    auto env = Environment::make_global();
+    for (auto const & sym : symbols) {
+        env.insert(sym, Number{1});
+    }
+
+    run("find"sv, lookups.size(), [&] {
+        auto found = std::size_t{0};
+        for (auto const & sym : lookups) {
+            found += env.find(sym) != env.end();
+        }
+
+        sink = sink + found;
+    });
+
+    // Nested scopes, every lookup misses twice before the globals
+    auto middle = Environment{&env};
+    auto inner = Environment{&middle};
+    run("find through 2 scopes"sv, lookups.size(), [&] {
+        auto found = std::size_t{0};
+        for (auto const & sym : lookups) {
+            found += inner.find(sym) != inner.end();
+        }
+
+        sink = sink + found;
+    });
+
+    // The tree walker looks every variable up every time
+    std::string defs{}, sum{"(+"};
+    for (auto i = 0; i < 200; ++i) {
+        defs += "(define v"s + std::to_string(i) + " 1)"s;
+        sum += " v"s + std::to_string(i);
+    }
+
+    sum += ")"s;
+    Interpreter walker{Interpreter::Engine::TreeWalker};
+    walker.eval_all(defs);
+    run("tree walker, 200 globals"sv, 200 * 2000, [&] {
+        for (auto i = 0; i < 2000; ++i) {
+            walker.eval(sum);
+        }
+    });
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,100 @@
+#include "lexer.hh"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+
+namespace {
+    using namespace std::literals::string_view_literals;
+    using namespace esquema;
+
+    // Something that looks like our configuration files: nested
+    // forms, long and short identifiers, numbers, indentation and
+    // the odd comment line. The wide flavor is what machine
+    // generated files look like, deep indentation and long
+    // qualified names, which is where skipping whole vectors pays.
+    std::string make_corpus(std::size_t bytes, bool wide) {
+        auto rng = std::mt19937{42};
+        auto pick = [&rng] (std::size_t n) {
+            return std::uniform_int_distribution<std::size_t>{0, n - 1}(rng);
+        };
+
+        auto const ids = wide
+            ? std::vector{
+                "ledger/reconciliation/customer-account-balance-after-adjustment"sv,
+                "rules/thresholds/maximum-number-of-retries-before-escalation"sv,
+                "normalize-ledger-entry-with-currency-conversion-and-rounding!"sv
+            }
+            : std::vector{
+                "define"sv, "if"sv, "begin"sv, "+"sv, "<="sv, "x"sv,
+                "rule-threshold"sv, "customer-account-balance"sv,
+                "max-retries"sv, "eqv?"sv, "normalize-ledger-entry!"sv
+            };
+
+        auto const indent = wide
+            ? "\n                                        ("sv
+            : "\n    ("sv;
+
+        std::string src{};
+        src.reserve(bytes + 1024);
+        while (src.size() < bytes) {
+            src += "; rule "sv;
+            src += std::to_string(pick(100000));
+            src += " generated for the benchmark\n"sv;
+            src += "(define "sv;
+            for (auto depth = 0; depth < 4; ++depth) {
+                src += indent;
+                for (auto i = pick(6) + 1; i > 0; --i) {
+                    if (pick(3) == 0) {
+                        src += std::to_string(pick(1000000));
+                        src += ".25"sv;
+                    }
+
+                    else {
+                        src += ids[pick(ids.size())];
+                    }
+
+                    src += ' ';
+                }
+
+                src += "#t"sv;
+            }
+
+            src += "))))\n\n"sv;
+        }
+
+        return src;
+    }
+
+    void run(std::string_view name, std::string const & src) {
+        auto best = 0.0;
+        auto tokens = std::size_t{0};
+        for (auto run = 0; run < 5; ++run) {
+            auto start = std::chrono::steady_clock::now();
+            Lexer lexer{src};
+            tokens = 0;
+            while (lexer.next() != Token::Type::Eof) {
+                ++tokens;
+            }
+
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            auto rate = static_cast<double>(src.size()) / (1 << 20) / elapsed.count();
+            if (rate > best) {
+                best = rate;
+            }
+        }
+
+        std::cout << "lexer ("sv << name << "): "sv << src.size() << " bytes, "sv
+                  << tokens << " tokens, best of 5: "sv << best << " MB/s\n"sv;
+    }
+}
+
+// Usage: lexer_bench [megabytes]
+int main(int argc, char ** argv) {
+    auto megabytes = argc > 1 ? std::atoi(argv[1]) : 64;
+    auto const bytes = static_cast<std::size_t>(megabytes) << 20;
+    run("typical"sv, make_corpus(bytes, false));
+    run("wide"sv, make_corpus(bytes, true));
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,96 @@
+#include "parallel_parser.hh"
+#include "parser.hh"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+
+namespace {
+    using namespace std::literals::string_view_literals;
+    using namespace esquema;
+
+    // A data file, lots of smallish records one after the other
+    std::string make_corpus(std::size_t bytes) {
+        auto rng = std::mt19937{42};
+        auto pick = [&rng] (std::size_t n) {
+            return std::uniform_int_distribution<std::size_t>{0, n - 1}(rng);
+        };
+
+        std::string src{};
+        src.reserve(bytes + 1024);
+        while (src.size() < bytes) {
+            src += "; record "sv;
+            src += std::to_string(pick(100000));
+            src += "\n(define record-"sv;
+            src += std::to_string(pick(100000));
+            src += "\n  (entry (account customer-"sv;
+            src += std::to_string(pick(1000));
+            src += ") (amount "sv;
+            src += std::to_string(pick(1000000));
+            src += ".25) (flags #t #f)))\n"sv;
+        }
+
+        return src;
+    }
+
+    // Machine generated data, a few forms nested thousands deep
+    std::string make_deep_corpus(std::size_t bytes, std::size_t depth) {
+        std::string src{};
+        src.reserve(bytes + 4 * depth);
+        while (src.size() < bytes) {
+            for (auto i = std::size_t{0}; i < depth; ++i) {
+                src += "(node "sv;
+            }
+
+            src += "leaf"sv;
+            src += std::string(depth, ')');
+            src += '\n';
+        }
+
+        return src;
+    }
+
+    template <typename Fn>
+    void run(std::string_view name, std::string const & src, Fn parse_all) {
+        auto best = 0.0;
+        auto forms = std::size_t{0};
+        for (auto run = 0; run < 5; ++run) {
+            auto start = std::chrono::steady_clock::now();
+            forms = parse_all(src).size();
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            auto rate = static_cast<double>(src.size()) / (1 << 20) / elapsed.count();
+            if (rate > best) {
+                best = rate;
+            }
+        }
+
+        std::cout << "parse_all ("sv << name << "): "sv << src.size() << " bytes, "sv
+                  << forms << " forms, best of 5: "sv << best << " MB/s\n"sv;
+    }
+}
+
+// Usage: parser_bench [megabytes] [threads]
+int main(int argc, char ** argv) {
+    auto megabytes = argc > 1 ? std::atoi(argv[1]) : 64;
+    auto threads = argc > 2 ? std::atoi(argv[2]) : 0;
+    auto const src = make_corpus(static_cast<std::size_t>(megabytes) << 20);
+
+    Parser serial{};
+    run("serial"sv, src, [&serial] (std::string_view src) -> List const & {
+        return serial.parse_all(src);
+    });
+
+    auto const deep = make_deep_corpus(static_cast<std::size_t>(megabytes) << 20, 10000);
+    run("serial, 10000 deep"sv, deep, [&serial] (std::string_view src) -> List const & {
+        return serial.parse_all(src);
+    });
+
+    ParallelParser parallel{static_cast<std::size_t>(threads)};
+    auto name = std::to_string(parallel.threads()) + " threads";
+    run(name, src, [&parallel] (std::string_view src) -> List const & {
+        return parallel.parse_all(src);
+    });
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,94 @@
+#include "arena.hh"
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+
+namespace esquema {
+    // Everything but the newest block goes back to the system. The
+    // newest block is also the biggest one so we keep that around.
+    void Arena::reset() noexcept {
+        if (!m_head) {
+            return;
+        }
+
+        auto block = m_head->next;
+        while (block) {
+            auto next = block->next;
+            std::free(block);
+            block = next;
+        }
+
+        m_head->next = nullptr;
+        m_cursor = data(m_head);
+        m_end = m_cursor + m_head->size;
+        m_used = 0;
+    }
+
+    std::size_t Arena::used() const noexcept {
+        return m_used;
+    }
+
+    std::size_t Arena::capacity() const noexcept {
+        auto total = std::size_t{0};
+        for (auto block = m_head; block; block = block->next) {
+            total += block->size;
+        }
+
+        return total;
+    }
+
+    Arena::Arena(std::size_t block_size)
+        : m_head{nullptr}, m_cursor{nullptr}, m_end{nullptr}
+        , m_block_size{block_size}, m_used{0}
+    { }
+
+    Arena::~Arena() {
+        auto block = m_head;
+        while (block) {
+            auto next = block->next;
+            std::free(block);
+            block = next;
+        }
+    }
+
+    void * Arena::do_allocate(std::size_t bytes, std::size_t align) {
+        auto addr = reinterpret_cast<std::uintptr_t>(m_cursor);
+        auto aligned = (addr + align - 1) & ~(std::uintptr_t{align} - 1);
+        if (!m_cursor || aligned + bytes > reinterpret_cast<std::uintptr_t>(m_end)) {
+            grow(bytes + align);
+            addr = reinterpret_cast<std::uintptr_t>(m_cursor);
+            aligned = (addr + align - 1) & ~(std::uintptr_t{align} - 1);
+        }
+
+        m_cursor = reinterpret_cast<char *>(aligned + bytes);
+        m_used += bytes;
+        return reinterpret_cast<void *>(aligned);
+    }
+
+    // Nothing to do, the memory comes back on reset
+    void Arena::do_deallocate(void *, std::size_t, std::size_t) noexcept
+    { }
+
+    bool Arena::do_is_equal(std::pmr::memory_resource const & other) const noexcept {
+        return this == &other;
+    }
+
+    void Arena::grow(std::size_t min_bytes) {
+        auto size = std::max(m_block_size, min_bytes);
+        auto block = static_cast<Block *>(std::malloc(sizeof(Block) + size));
+        if (!block) {
+            throw std::bad_alloc{};
+        }
+
+        block->next = m_head;
+        block->size = size;
+        m_head = block;
+        m_cursor = data(block);
+        m_end = m_cursor + size;
+        m_block_size = size * 2;
+    }
+
+    char * Arena::data(Block * block) noexcept {
+        return reinterpret_cast<char *>(block + 1);
+    }
+}
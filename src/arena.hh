@@ -0,0 +1,65 @@
+#ifndef ESQUEMA_ARENA_HH_INCLUDED
+#define ESQUEMA_ARENA_HH_INCLUDED
+
+#include <cstddef>
+#include <memory_resource>
+#include <new>
+#include <utility>
+
+namespace esquema {
+    // A bump allocator. Allocating is moving a pointer, deallocating
+    // does nothing at all, and reset() lets go of everything handed
+    // out at once. Blocks double in size as the arena grows and reset
+    // hangs on to the biggest one, so once an arena has seen a form
+    // as big as the ones you're parsing it stops calling malloc.
+    // It's a std::pmr::memory_resource so the standard containers
+    // can allocate from it.
+    class Arena : public std::pmr::memory_resource {
+    // Interface
+    public:
+        // Builds a T in the arena. Its destructor is never run, so
+        // only use this for things that own nothing but arena memory.
+        template <typename T, typename... Args>
+        T * make(Args &&... args) {
+            auto mem = allocate(sizeof(T), alignof(T));
+            return ::new (mem) T(std::forward<Args>(args)...);
+        }
+
+        void reset() noexcept;
+        std::size_t used() const noexcept;
+        std::size_t capacity() const noexcept;
+
+    // Constructors
+    public:
+        explicit Arena(std::size_t block_size = 16 * 1024);
+        Arena(Arena const &) = delete;
+        Arena & operator=(Arena const &) = delete;
+        ~Arena() override;
+
+    // memory_resource interface
+    private:
+        void * do_allocate(std::size_t bytes, std::size_t align) override;
+        void do_deallocate(void * ptr, std::size_t bytes, std::size_t align) noexcept override;
+        bool do_is_equal(std::pmr::memory_resource const & other) const noexcept override;
+
+    // Details
+    private:
+        struct Block {
+            Block * next;
+            std::size_t size;
+        };
+
+        void grow(std::size_t min_bytes);
+        static char * data(Block * block) noexcept;
+
+    // Data
+    private:
+        Block * m_head;
+        char * m_cursor;
+        char * m_end;
+        std::size_t m_block_size;
+        std::size_t m_used;
+    };
+}
+
+#endif
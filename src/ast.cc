@@ -1,4 +1,7 @@
 #include "ast.hh"
+#include "bigint.hh"
+#include "intern.hh"
+#include <charconv>
 #include <ostream>
 #include <stdexcept>
 #include <sstream>
@@ -10,21 +13,33 @@ namespace {
 
 namespace esquema {
     std::ostream & operator<<(std::ostream & ostr, Symbol const & sym) {
-        return ostr << sym.m_value;
+        return ostr << sym.value();
     }
 
     bool Symbol::operator==(CIStringView value) const noexcept {
-        return m_value == value;
+        return this->value() == value;
     }
 
     CIString const & Symbol::value() const noexcept {
-        return m_value;
+        return SymbolTable::global().name(m_id);
+    }
+
+    std::uint32_t Symbol::id() const noexcept {
+        return m_id;
+    }
+
+    bool Symbol::is_keyword() const noexcept {
+        return m_id < NumKeywords;
     }
 
     Symbol::Symbol(std::string_view value)
-        : m_value{value.data(), value.size()}
+        : m_id{SymbolTable::global().intern(value)}
     { }
 
+    Symbol Symbol::from_id(std::uint32_t id) noexcept {
+        return Symbol{IdTag{}, id};
+    }
+
     std::ostream & operator<<(std::ostream & ostr, Bool const & bool_) {
         if (bool_.m_value) {
             return ostr << "#t";
@@ -42,18 +57,118 @@ namespace esquema {
         : m_value{value}
     { }
 
+    // With the stream in its default state this prints exactly what
+    // ostr << double would, %g at the stream's precision, but without
+    // going through the locale and num_put machinery. Anything fancier
+    // goes the long way around. Exact ones get all their digits.
     std::ostream & operator<<(std::ostream & ostr, Number const & num) {
-        return ostr << num.m_value;
+        auto const fancy = std::ios_base::floatfield | std::ios_base::showpos
+                         | std::ios_base::showpoint | std::ios_base::uppercase;
+        if (num.is_big()) {
+            return ostr << num.big();
+        }
+
+        auto const * exact = std::get_if<std::int64_t>(&num.m_value);
+        if ((ostr.flags() & fancy) || ostr.width() != 0) {
+            return exact ? ostr << *exact : ostr << num.value();
+        }
+
+        char buf[64];
+        auto precision = static_cast<int>(ostr.precision());
+        auto [ptr, ec] = exact
+            ? std::to_chars(buf, buf + sizeof(buf), *exact)
+            : std::to_chars(
+                buf, buf + sizeof(buf), num.value(),
+                std::chars_format::general, precision == 0 ? 1 : precision
+            );
+
+        if (ec != std::errc{}) {
+            return ostr << num.value();
+        }
+
+        return ostr.write(buf, ptr - buf);
     }
 
     double Number::value() const noexcept {
-        return m_value;
+        if (auto const * exact = std::get_if<std::int64_t>(&m_value)) {
+            return static_cast<double>(*exact);
+        }
+
+        if (is_big()) {
+            return big().to_double();
+        }
+
+        return *std::get_if<double>(&m_value);
+    }
+
+    bool Number::is_exact() const noexcept {
+        return !std::holds_alternative<double>(m_value);
+    }
+
+    bool Number::is_big() const noexcept {
+        return std::holds_alternative<std::shared_ptr<BigInt const>>(m_value);
+    }
+
+    std::int64_t const * Number::fixnum() const noexcept {
+        return std::get_if<std::int64_t>(&m_value);
+    }
+
+    std::int64_t Number::exact() const noexcept {
+        return *std::get_if<std::int64_t>(&m_value);
+    }
+
+    BigInt const & Number::big() const noexcept {
+        return **std::get_if<std::shared_ptr<BigInt const>>(&m_value);
+    }
+
+    Number Number::from_integer(std::int64_t value) noexcept {
+        auto num = Number{0.0};
+        num.m_value = value;
+        return num;
+    }
+
+    Number Number::from_bigint(BigInt value) {
+        if (value.fits_int64()) {
+            return from_integer(value.to_int64());
+        }
+
+        return Number{std::make_shared<BigInt const>(std::move(value))};
+    }
+
+    Number Number::borrow_bigint(BigInt const & value) {
+        if (value.fits_int64()) {
+            return from_integer(value.to_int64());
+        }
+
+        return Number{std::shared_ptr<BigInt const>{std::shared_ptr<void>{}, &value}};
     }
 
     Number::Number(double value) 
         : m_value{value}
     { }
 
+    Number::Number(std::shared_ptr<BigInt const> value) noexcept
+        : m_value{std::move(value)}
+    { }
+
+    // A borrowed BigInt has no owner to count its uses
+    Number::Number(Number const & other)
+        : m_value{other.m_value}
+    {
+        auto * big = std::get_if<std::shared_ptr<BigInt const>>(&m_value);
+        if (big && big->use_count() == 0) {
+            *big = std::make_shared<BigInt const>(**big);
+        }
+    }
+
+    Number & Number::operator=(Number const & other) {
+        if (this != &other) {
+            *this = Number{other};
+        }
+
+        return *this;
+    }
+
     std::ostream & operator<<(std::ostream & ostr, Nil) {
         return ostr << "Nil";
     }
@@ -62,6 +177,15 @@ namespace esquema {
         return ostr << "Proc";
     }
 
+    // Natives and procs look the same to the user
+    std::ostream & operator<<(std::ostream & ostr, Native) {
+        return ostr << "Proc";
+    }
+
+    std::ostream & operator<<(std::ostream & ostr, Lambda const &) {
+        return ostr << "Lambda";
+    }
+
     std::ostream & operator<<(std::ostream & ostr, List const & list) {
         ostr << '(';
         if (list.empty()) {
@@ -101,6 +225,12 @@ namespace esquema {
         else if (auto ptr = std::get_if<Proc>(&cell)) {
             ostr << *ptr;
         }
+        else if (auto ptr = std::get_if<Native>(&cell)) {
+            ostr << *ptr;
+        }
+        else if (auto ptr = std::get_if<Lambda>(&cell)) {
+            ostr << *ptr;
+        }
 
         return ostr;
     }
@@ -132,4 +262,12 @@ namespace esquema {
     bool Cell::is_proc() const noexcept {
         return std::holds_alternative<Proc>(*this);
     }
+
+    bool Cell::is_native() const noexcept {
+        return std::holds_alternative<Native>(*this);
+    }
+
+    bool Cell::is_lambda() const noexcept {
+        return std::holds_alternative<Lambda>(*this);
+    }
 }
@@ -2,16 +2,29 @@
 #define ESQUEMA_AST_HH_INCLUDED
 
 #include "ci_string.hh"
+#include <cstdint>
 #include <iosfwd>
-#include <list>
 #include <memory>
+#include <memory_resource>
 #include <optional>
+#include <span>
 #include <variant>
+#include <vector>
 
 namespace esquema {
     // A Symbol in Scheme can bind to a value or a procedure that
     // you later can call. For right now I only support values.
+    // Symbols are interned in the global SymbolTable so all a
+    // Symbol carries around is its id.
     class Symbol {
+    public:
+        // The special forms are interned before anything else
+        // so their ids are known up front. Folded is the Optimizer's,
+        // its name is one the Lexer won't let anybody write.
+        enum Keyword : std::uint32_t {
+            Define, If, Begin, Lambda, Folded, NumKeywords
+        };
+
     // Friends
     public:
         friend std::ostream & operator<<(std::ostream & ostr, Symbol const & sym);
@@ -19,18 +32,30 @@ namespace esquema {
     // Operators
     public:
         bool operator==(CIStringView value) const noexcept;
+        bool operator==(Symbol const & other) const noexcept = default;
 
     // Interface
     public:
         CIString const & value() const noexcept;
+        std::uint32_t id() const noexcept;
+        bool is_keyword() const noexcept;
 
     // Constructors
     public:
         explicit Symbol(std::string_view value);
 
+        // Only for ids that came out of the SymbolTable
+        static Symbol from_id(std::uint32_t id) noexcept;
+
+    private:
+        struct IdTag {};
+        constexpr Symbol(IdTag, std::uint32_t id) noexcept
+            : m_id{id}
+        { }
+
     // Data
     private:
-        CIString m_value;
+        std::uint32_t m_id;
     };
 
     // Bool in Scheme is any of: #t, #T, #f, #F. Other
@@ -53,10 +78,17 @@ namespace esquema {
         bool m_value;
     };
 
-    // Numbers in scheme all go to floating point
-
-    // TODO - It'd be nice to support bigint and unlimited
-    // precision numbers, but I'm not doing that right now.
+    class BigInt;
+
+    // Numbers are either exact integers or inexact doubles, the
+    // same split Scheme makes. Integer literals are exact and so is
+    // arithmetic on them, as big as they get, see native_proc.cc.
+    // Exact ones that don't fit in 64 bits are BigInts.
+    //
+    // The Parser's trees never get their destructors run, see List,
+    // so a big literal there only borrows its BigInt from the Parser.
+    // That's a shared_ptr with nothing behind it to own, it points at
+    // the Parser's. Copying a Number that borrows makes one that owns.
     class Number {
     // Friends
     public:
@@ -64,40 +96,83 @@ namespace esquema {
 
     // Interface
     public:
+        // Whichever it is, as a double
         double value() const noexcept;
+        bool is_exact() const noexcept;
+
+        bool is_big() const noexcept;
+
+        // The int64_t, or null when it's a double or a BigInt
+        std::int64_t const * fixnum() const noexcept;
+
+        // These don't check, ask first. is_exact() isn't asking
+        // enough for exact(), a BigInt is exact too.
+        std::int64_t exact() const noexcept;
+        BigInt const & big() const noexcept;
+
+        static Number from_integer(std::int64_t value) noexcept;
+
+        // Both go back to a plain exact integer if it fits. value
+        // has to outlive whatever borrows it, copies excepted.
+        static Number from_bigint(BigInt value);
+        static Number borrow_bigint(BigInt const & value);
 
     // Constructors
     public:
         explicit Number(double value);
+        Number(Number const & other);
+        Number(Number &&) noexcept = default;
+        Number & operator=(Number const & other);
+        Number & operator=(Number &&) noexcept = default;
+        ~Number() = default;
+
+    private:
+        explicit Number(std::shared_ptr<BigInt const> value) noexcept;
 
     // Data
     private:
-        double m_value;
+        // Inexact, exact, or exact and too big for an int64_t
+        std::variant<double, std::int64_t, std::shared_ptr<BigInt const>> m_value;
     };
 
     // Forward declare this to get out of a tight situation
     class Cell;
 
-    // I use list because there can be lists of lists of lists
-    // and when a vector reallocates that would be a beast
-    // so list it is.
-
-    // TODO - maybe this could be forward_list instead of a doublely
-    // linked list
-    using List = std::list<Cell>;
+    // Lists are contiguous and take a polymorphic allocator. The
+    // Parser builds each list at its final size inside its Arena so
+    // a whole tree is a handful of bump allocations. Copying a List
+    // always lands on the regular heap, which means anything that
+    // escapes the parse tree by copy outlives the arena safely.
+    using List = std::pmr::vector<Cell>;
     std::ostream & operator<<(std::ostream & ostr, List const & list);
 
 
     // Also forward declare this to avoid another tight situation
     class Environment;
 
-    // A proc is just a function pointer for right now.
-
-    // TODO - I could change this to std::function and
-    // do all sorts of stateful things
+    // A proc is just a function pointer. This is the old calling
+    // convention, every call needs a List of the arguments, and it
+    // is kept so that procs written against it still work.
     using Proc = Cell(*)(List const &, Environment *);
     std::ostream & operator<<(std::ostream & ostr, Proc);
 
+    // The builtins use this one instead. The arguments are a span
+    // over the evaluated Values right where they already are, on the
+    // VM's stack say, so calling one doesn't allocate anything.
+    // Anything the native makes goes on the caller's Heap.
+    class Value;
+    class Heap;
+    using Native = Value(*)(std::span<Value const> args, Heap & heap);
+    std::ostream & operator<<(std::ostream & ostr, Native);
+
+    // What a lambda expression evaluates to. The Closure itself
+    // lives on a Heap, a Lambda is a handle that pins it there so
+    // the collector leaves it alone while the Lambda is around. It
+    // is only good for as long as that Heap is, see closure.hh
+    class Closure;
+    using Lambda = std::shared_ptr<Closure const>;
+    std::ostream & operator<<(std::ostream & ostr, Lambda const & lambda);
+
     // Represents nothing at all, some operations return it
     class Nil {};
     std::ostream & operator<<(std::ostream & ostr, Nil);
@@ -107,7 +182,7 @@ namespace esquema {
     // all the nice constructors that the stdlib implementators
     // wrote for my benefit. Further down I extend namespace
     // std to allow for the variant non-member functions to work
-    class Cell : public std::variant<Nil, Symbol, Bool, Number, List, Proc> {
+    class Cell : public std::variant<Nil, Symbol, Bool, Number, List, Proc, Native, Lambda> {
     // Friends
     public:
         friend std::ostream & operator<<(std::ostream & ostr, Cell const & cell);
@@ -121,6 +196,8 @@ namespace esquema {
         bool is_atom() const noexcept;
         bool is_list() const noexcept;
         bool is_proc() const noexcept;
+        bool is_native() const noexcept;
+        bool is_lambda() const noexcept;
 
     // Constructors
     public:
@@ -133,6 +210,14 @@ namespace esquema {
 // implementators welcome template specializations in namespace
 // std
 namespace std {
+    template <>
+    struct hash <esquema::Symbol> {
+    public:
+        size_t operator()(esquema::Symbol const & sym) const noexcept {
+            return sym.id();
+        }
+    };
+
     template <>
     struct variant_size <esquema::Cell> 
         : variant_size <esquema::Cell::variant>
@@ -0,0 +1,511 @@
+#include "bigint.hh"
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cmath>
+#include <ostream>
+#include <utility>
+#include <vector>
+
+namespace {
+    using limb = std::uint64_t;
+    using wide = unsigned __int128;
+
+    // The magnitude routines work on plain runs of limbs, least
+    // significant first. The result may be the same run as the first
+    // operand but mustn't otherwise overlap, unless it says so.
+
+    // r = a + b, both n limbs, returns the carry
+    limb add_n(limb * r, limb const * a, limb const * b, std::size_t n) noexcept {
+        auto carry = limb{0};
+        for (auto i = std::size_t{0}; i < n; ++i) {
+            auto sum = static_cast<wide>(a[i]) + b[i] + carry;
+            r[i] = static_cast<limb>(sum);
+            carry = static_cast<limb>(sum >> 64);
+        }
+
+        return carry;
+    }
+
+    // r = a + carry, n limbs
+    limb add_1(limb * r, limb const * a, std::size_t n, limb carry) noexcept {
+        for (auto i = std::size_t{0}; i < n; ++i) {
+            auto sum = a[i] + carry;
+            carry = sum < carry;
+            r[i] = sum;
+        }
+
+        return carry;
+    }
+
+    // r = a - b, both n limbs, returns the borrow
+    limb sub_n(limb * r, limb const * a, limb const * b, std::size_t n) noexcept {
+        auto borrow = limb{0};
+        for (auto i = std::size_t{0}; i < n; ++i) {
+            auto diff = a[i] - b[i];
+            auto next = limb{a[i] < b[i]};
+            next |= diff < borrow;
+            r[i] = diff - borrow;
+            borrow = next;
+        }
+
+        return borrow;
+    }
+
+    // r = a - borrow, n limbs
+    limb sub_1(limb * r, limb const * a, std::size_t n, limb borrow) noexcept {
+        for (auto i = std::size_t{0}; i < n; ++i) {
+            auto next = limb{a[i] < borrow};
+            r[i] = a[i] - borrow;
+            borrow = next;
+        }
+
+        return borrow;
+    }
+
+    // r = a + b and r = a - b where an >= bn, r has an limbs
+    limb add(limb * r, limb const * a, std::size_t an, limb const * b, std::size_t bn) noexcept {
+        auto carry = add_n(r, a, b, bn);
+        return add_1(r + bn, a + bn, an - bn, carry);
+    }
+
+    limb sub(limb * r, limb const * a, std::size_t an, limb const * b, std::size_t bn) noexcept {
+        auto borrow = sub_n(r, a, b, bn);
+        return sub_1(r + bn, a + bn, an - bn, borrow);
+    }
+
+    // Neither has zero limbs on top
+    int compare(limb const * a, std::size_t an, limb const * b, std::size_t bn) noexcept {
+        if (an != bn) {
+            return an < bn ? -1 : 1;
+        }
+
+        for (auto i = an; i-- > 0;) {
+            if (a[i] != b[i]) {
+                return a[i] < b[i] ? -1 : 1;
+            }
+        }
+
+        return 0;
+    }
+
+    // a = a * m + carry in place, returns what's carried out the top
+    limb mul_1_add(limb * a, std::size_t n, limb m, limb carry) noexcept {
+        for (auto i = std::size_t{0}; i < n; ++i) {
+            auto prod = static_cast<wide>(a[i]) * m + carry;
+            a[i] = static_cast<limb>(prod);
+            carry = static_cast<limb>(prod >> 64);
+        }
+
+        return carry;
+    }
+
+    // a = a / d in place, returns the remainder
+    limb div_1(limb * a, std::size_t n, limb d) noexcept {
+        auto rem = wide{0};
+        for (auto i = n; i-- > 0;) {
+            auto cur = (rem << 64) | a[i];
+            a[i] = static_cast<limb>(cur / d);
+            rem = cur % d;
+        }
+
+        return static_cast<limb>(rem);
+    }
+
+    void mul(limb * r, limb const * a, std::size_t an, limb const * b, std::size_t bn);
+
+    // r = a * b, r has an + bn limbs
+    void mul_basecase(limb * r, limb const * a, std::size_t an, limb const * b, std::size_t bn) noexcept {
+        std::fill(r, r + an + bn, limb{0});
+        for (auto i = std::size_t{0}; i < bn; ++i) {
+            auto carry = limb{0};
+            for (auto j = std::size_t{0}; j < an; ++j) {
+                auto prod = static_cast<wide>(a[j]) * b[i] + r[i + j] + carry;
+                r[i + j] = static_cast<limb>(prod);
+                carry = static_cast<limb>(prod >> 64);
+            }
+            r[i + an] = carry;
+        }
+    }
+
+    // With a = a1 B^m + a0 and b = b1 B^m + b0 the product is
+    // z2 B^2m + z1 B^m + z0, where z0 = a0 b0, z2 = a1 b1 and
+    // z1 = (a0 + a1)(b0 + b1) - z0 - z2. Three multiplications
+    // of half the size instead of four. Needs an >= bn > an / 2.
+    void mul_karatsuba(limb * r, limb const * a, std::size_t an, limb const * b, std::size_t bn) {
+        auto const m = an / 2;
+        auto const a1n = an - m;
+        auto const b1n = bn - m;
+
+        // z0 and z2 go straight into the bottom and top of r
+        mul(r, a, m, b, m);
+        mul(r + 2 * m, a + m, a1n, b + m, b1n);
+
+        auto const san = a1n + 1;
+        auto const sbn = std::max(m, b1n) + 1;
+        auto z1n = san + sbn;
+        std::vector<limb> scratch(san + sbn + z1n);
+        auto sa = scratch.data();
+        auto sb = sa + san;
+        auto z1 = sb + sbn;
+
+        sa[a1n] = add(sa, a + m, a1n, a, m);
+        if (b1n >= m) {
+            sb[b1n] = add(sb, b + m, b1n, b, m);
+        }
+        else {
+            sb[m] = add(sb, b, m, b + m, b1n);
+        }
+
+        mul(z1, sa, san, sb, sbn);
+        [[maybe_unused]] auto borrow = sub(z1, z1, z1n, r, 2 * m);
+        borrow |= sub(z1, z1, z1n, r + 2 * m, an + bn - 2 * m);
+        assert(borrow == 0 && "z1 can't be negative");
+
+        // What's left of z1 fits, whatever sa and sb made room for
+        while (z1n > 0 && z1[z1n - 1] == 0) {
+            --z1n;
+        }
+
+        [[maybe_unused]] auto carry = add(r + m, r + m, an + bn - m, z1, z1n);
+        assert(carry == 0 && "the product has to fit");
+    }
+
+    // One side much longer than the other, so it's cut into pieces
+    // as long as the short side and those get multiplied and added
+    void mul_unbalanced(limb * r, limb const * a, std::size_t an, limb const * b, std::size_t bn) {
+        std::fill(r, r + an + bn, limb{0});
+        std::vector<limb> piece(2 * bn);
+        for (auto i = std::size_t{0}; i < an; i += bn) {
+            auto len = std::min(bn, an - i);
+            mul(piece.data(), a + i, len, b, bn);
+            add(r + i, r + i, an + bn - i, piece.data(), len + bn);
+        }
+    }
+
+    // r = a * b, r has an + bn limbs and overlaps neither
+    void mul(limb * r, limb const * a, std::size_t an, limb const * b, std::size_t bn) {
+        if (an < bn) {
+            std::swap(a, b);
+            std::swap(an, bn);
+        }
+
+        // Multiplying by a fixnum is the common case by far
+        if (bn == 1) {
+            std::copy_n(a, an, r);
+            r[an] = mul_1_add(r, an, b[0], 0);
+        }
+        else if (bn < esquema::BigInt::karatsuba_threshold) {
+            mul_basecase(r, a, an, b, bn);
+        }
+        else if (2 * bn <= an) {
+            mul_unbalanced(r, a, an, b, bn);
+        }
+        else {
+            mul_karatsuba(r, a, an, b, bn);
+        }
+    }
+
+    // The biggest power of ten that fits in a limb
+    constexpr auto ten_19 = limb{10'000'000'000'000'000'000u};
+}
+
+namespace esquema {
+    std::ostream & operator<<(std::ostream & ostr, BigInt const & num) {
+        return ostr << num.to_string();
+    }
+
+    BigInt operator+(BigInt const & lhs, BigInt const & rhs) {
+        return BigInt::add(lhs, rhs, rhs.m_negative);
+    }
+
+    BigInt operator-(BigInt const & lhs, BigInt const & rhs) {
+        return BigInt::add(lhs, rhs, !rhs.m_negative && !rhs.is_zero());
+    }
+
+    BigInt operator*(BigInt const & lhs, BigInt const & rhs) {
+        if (lhs.is_zero() || rhs.is_zero()) {
+            return BigInt{};
+        }
+
+        BigInt result{};
+        result.resize(lhs.m_size + rhs.m_size);
+        mul(result.data(), lhs.data(), lhs.m_size, rhs.data(), rhs.m_size);
+        result.m_negative = lhs.m_negative != rhs.m_negative;
+        result.trim();
+        return result;
+    }
+
+    bool operator==(BigInt const & lhs, BigInt const & rhs) noexcept {
+        return lhs.m_negative == rhs.m_negative
+            && std::ranges::equal(lhs.limbs(), rhs.limbs());
+    }
+
+    std::strong_ordering operator<=>(BigInt const & lhs, BigInt const & rhs) noexcept {
+        if (lhs.m_negative != rhs.m_negative) {
+            return lhs.m_negative ? std::strong_ordering::less : std::strong_ordering::greater;
+        }
+
+        auto cmp = compare(lhs.data(), lhs.m_size, rhs.data(), rhs.m_size);
+        if (lhs.m_negative) {
+            cmp = -cmp;
+        }
+
+        return cmp <=> 0;
+    }
+
+    bool BigInt::is_negative() const noexcept {
+        return m_negative;
+    }
+
+    bool BigInt::is_zero() const noexcept {
+        return m_size == 0;
+    }
+
+    std::span<std::uint64_t const> BigInt::limbs() const noexcept {
+        return {data(), m_size};
+    }
+
+    bool BigInt::fits_int64() const noexcept {
+        if (m_size > 1) {
+            return false;
+        }
+
+        auto const top = std::uint64_t{1} << 63;
+        return m_size == 0 || data()[0] < top || (m_negative && data()[0] == top);
+    }
+
+    std::int64_t BigInt::to_int64() const noexcept {
+        auto mag = m_size == 0 ? std::uint64_t{0} : data()[0];
+        return static_cast<std::int64_t>(m_negative ? ~mag + 1 : mag);
+    }
+
+    // The top 64 bits go to the conversion with one more bit stuck
+    // on the bottom if anything under them is set, that's enough for
+    // it to round the way it would with all the bits there
+    double BigInt::to_double() const noexcept {
+        if (m_size == 0) {
+            return 0.0;
+        }
+
+        auto const top = m_size - 1;
+        auto const shift = std::countl_zero(data()[top]);
+        auto mantissa = data()[top] << shift;
+        auto sticky = false;
+        if (top > 0) {
+            auto next = data()[top - 1];
+            if (shift > 0) {
+                mantissa |= next >> (64 - shift);
+            }
+
+            sticky = (next << shift) != 0;
+            for (auto i = std::size_t{0}; !sticky && i + 1 < top; ++i) {
+                sticky = data()[i] != 0;
+            }
+        }
+
+        auto result = std::ldexp(
+            static_cast<double>(mantissa | limb{sticky}),
+            static_cast<int>(64 * top) - shift
+        );
+
+        return m_negative ? -result : result;
+    }
+
+    // Nineteen digits at a time off the bottom
+    std::string BigInt::to_string() const {
+        if (m_size == 0) {
+            return "0";
+        }
+
+        std::vector<limb> mag(data(), data() + m_size);
+        std::string digits{};
+        digits.reserve(m_size * 20 + 1);
+        auto size = mag.size();
+        while (size > 0) {
+            auto chunk = div_1(mag.data(), size, ten_19);
+            while (size > 0 && mag[size - 1] == 0) {
+                --size;
+            }
+
+            for (auto i = 0; i < 19 && (size > 0 || chunk != 0); ++i) {
+                digits.push_back(static_cast<char>('0' + chunk % 10));
+                chunk /= 10;
+            }
+        }
+
+        if (m_negative) {
+            digits.push_back('-');
+        }
+
+        std::reverse(digits.begin(), digits.end());
+        return digits;
+    }
+
+    BigInt BigInt::operator-() const {
+        auto result = *this;
+        result.m_negative = !m_negative && m_size != 0;
+        return result;
+    }
+
+    // Nineteen digits at a time onto the bottom
+    std::optional<BigInt> BigInt::from_string(std::string_view txt) {
+        auto negative = false;
+        if (!txt.empty() && (txt.front() == '-' || txt.front() == '+')) {
+            negative = txt.front() == '-';
+            txt.remove_prefix(1);
+        }
+
+        if (txt.empty() || !std::ranges::all_of(txt, [] (char c) { return c >= '0' && c <= '9'; })) {
+            return std::nullopt;
+        }
+
+        BigInt result{};
+        result.resize(txt.size() / 19 + 1);
+        auto used = std::size_t{0};
+        while (!txt.empty()) {
+            auto len = txt.size() % 19 == 0 ? std::size_t{19} : txt.size() % 19;
+            auto chunk = limb{0};
+            auto scale = limb{1};
+            for (auto c : txt.substr(0, len)) {
+                chunk = chunk * 10 + static_cast<limb>(c - '0');
+                scale *= 10;
+            }
+
+            auto carry = mul_1_add(result.data(), used, scale, chunk);
+            if (carry != 0) {
+                result.data()[used++] = carry;
+            }
+            txt.remove_prefix(len);
+        }
+
+        result.m_size = used;
+        result.m_negative = negative && used != 0;
+        return result;
+    }
+
+    BigInt::BigInt() noexcept
+        : m_heap{}, m_inline{}, m_size{0}, m_capacity{inline_limbs}, m_negative{false}
+    { }
+
+    BigInt::BigInt(std::int64_t value) noexcept
+        : BigInt{}
+    {
+        if (value != 0) {
+            auto mag = static_cast<std::uint64_t>(value);
+            m_inline[0] = value < 0 ? ~mag + 1 : mag;
+            m_size = 1;
+            m_negative = value < 0;
+        }
+    }
+
+    BigInt::BigInt(BigInt const & other)
+        : BigInt{}
+    {
+        resize(other.m_size);
+        std::copy_n(other.data(), other.m_size, data());
+        m_negative = other.m_negative;
+    }
+
+    BigInt::BigInt(BigInt && other) noexcept
+        : m_heap{std::move(other.m_heap)}, m_inline{}, m_size{other.m_size}
+        , m_capacity{other.m_capacity}, m_negative{other.m_negative}
+    {
+        if (!m_heap) {
+            std::copy_n(other.m_inline, inline_limbs, m_inline);
+        }
+
+        other.m_size = 0;
+        other.m_capacity = inline_limbs;
+        other.m_negative = false;
+    }
+
+    BigInt & BigInt::operator=(BigInt const & other) {
+        if (this != &other) {
+            m_size = 0;
+            resize(other.m_size);
+            std::copy_n(other.data(), other.m_size, data());
+            m_negative = other.m_negative;
+        }
+
+        return *this;
+    }
+
+    BigInt & BigInt::operator=(BigInt && other) noexcept {
+        if (this != &other) {
+            m_heap = std::move(other.m_heap);
+            if (!m_heap) {
+                std::copy_n(other.m_inline, inline_limbs, m_inline);
+            }
+
+            m_size = std::exchange(other.m_size, 0);
+            m_capacity = std::exchange(other.m_capacity, inline_limbs);
+            m_negative = std::exchange(other.m_negative, false);
+        }
+
+        return *this;
+    }
+
+    std::uint64_t * BigInt::data() noexcept {
+        return m_heap ? m_heap.get() : m_inline;
+    }
+
+    std::uint64_t const * BigInt::data() const noexcept {
+        return m_heap ? m_heap.get() : m_inline;
+    }
+
+    void BigInt::resize(std::size_t size) {
+        if (size > m_capacity) {
+            auto capacity = std::max(size, 2 * m_capacity);
+            auto heap = std::make_unique<std::uint64_t[]>(capacity);
+            std::copy_n(data(), m_size, heap.get());
+            m_heap = std::move(heap);
+            m_capacity = capacity;
+        }
+        else if (size > m_size) {
+            std::fill(data() + m_size, data() + size, std::uint64_t{0});
+        }
+
+        m_size = size;
+    }
+
+    void BigInt::trim() noexcept {
+        while (m_size > 0 && data()[m_size - 1] == 0) {
+            --m_size;
+        }
+
+        if (m_size == 0) {
+            m_negative = false;
+        }
+    }
+
+    // lhs + rhs with rhs taking the sign it's given, which is how
+    // subtraction gets done too
+    BigInt BigInt::add(BigInt const & lhs, BigInt const & rhs, bool rhs_negative) {
+        BigInt result{};
+        if (lhs.m_negative == rhs_negative) {
+            auto const * big = &lhs;
+            auto const * small = &rhs;
+            if (big->m_size < small->m_size) {
+                std::swap(big, small);
+            }
+
+            result.resize(big->m_size + 1);
+            result.data()[big->m_size] = ::add(
+                result.data(), big->data(), big->m_size, small->data(), small->m_size
+            );
+            result.m_negative = lhs.m_negative;
+        }
+        else {
+            auto cmp = compare(lhs.data(), lhs.m_size, rhs.data(), rhs.m_size);
+            auto const & big = cmp >= 0 ? lhs : rhs;
+            auto const & small = cmp >= 0 ? rhs : lhs;
+            result.resize(big.m_size);
+            sub(result.data(), big.data(), big.m_size, small.data(), small.m_size);
+            result.m_negative = cmp >= 0 ? lhs.m_negative : rhs_negative;
+        }
+
+        result.trim();
+        return result;
+    }
+}
@@ -0,0 +1,92 @@
+#ifndef ESQUEMA_BIGINT_HH_INCLUDED
+#define ESQUEMA_BIGINT_HH_INCLUDED
+
+#include <compare>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+
+namespace esquema {
+    // An integer as big as it needs to be. The magnitude is kept in
+    // 64 bit limbs, least significant first, with the sign off to the
+    // side. There's never a zero limb on top, so zero has no limbs at
+    // all and is never negative. The first couple of limbs live right
+    // in the BigInt, which covers everything that has only just
+    // spilled out of a fixnum without a trip to malloc.
+    //
+    // Multiplication is the schoolbook one for small numbers and
+    // Karatsuba once both sides have karatsuba_threshold limbs or
+    // more, that's where it started winning on my machine.
+    class BigInt {
+    public:
+        static constexpr std::size_t inline_limbs = 2;
+        static constexpr std::size_t karatsuba_threshold = 32;
+
+    // Friends
+    public:
+        friend std::ostream & operator<<(std::ostream & ostr, BigInt const & num);
+        friend BigInt operator+(BigInt const & lhs, BigInt const & rhs);
+        friend BigInt operator-(BigInt const & lhs, BigInt const & rhs);
+        friend BigInt operator*(BigInt const & lhs, BigInt const & rhs);
+        friend bool operator==(BigInt const & lhs, BigInt const & rhs) noexcept;
+        friend std::strong_ordering operator<=>(BigInt const & lhs, BigInt const & rhs) noexcept;
+
+    // Interface
+    public:
+        bool is_negative() const noexcept;
+        bool is_zero() const noexcept;
+        std::span<std::uint64_t const> limbs() const noexcept;
+
+        bool fits_int64() const noexcept;
+
+        // This doesn't check, ask first
+        std::int64_t to_int64() const noexcept;
+
+        // The nearest double, or an infinity
+        double to_double() const noexcept;
+        std::string to_string() const;
+
+        BigInt operator-() const;
+
+        // An optional sign and then decimal digits, nothing else
+        static std::optional<BigInt> from_string(std::string_view txt);
+
+    // Constructors
+    public:
+        BigInt() noexcept;
+        explicit BigInt(std::int64_t value) noexcept;
+        BigInt(BigInt const & other);
+        BigInt(BigInt && other) noexcept;
+        BigInt & operator=(BigInt const & other);
+        BigInt & operator=(BigInt && other) noexcept;
+        ~BigInt() = default;
+
+    // Helpers
+    private:
+        std::uint64_t * data() noexcept;
+        std::uint64_t const * data() const noexcept;
+
+        // Limbs that were there stay, new ones are zero
+        void resize(std::size_t size);
+
+        // Drops the zero limbs from the top
+        void trim() noexcept;
+
+        static BigInt add(BigInt const & lhs, BigInt const & rhs, bool rhs_negative);
+
+    // Data
+    private:
+        std::unique_ptr<std::uint64_t[]> m_heap;
+        std::uint64_t m_inline[inline_limbs];
+        std::size_t m_size;
+        std::size_t m_capacity;
+        bool m_negative;
+    };
+}
+
+#endif
@@ -0,0 +1,80 @@
+#ifndef ESQUEMA_BUILTINS_HH_INCLUDED
+#define ESQUEMA_BUILTINS_HH_INCLUDED
+
+#include "ast.hh"
+#include "native_proc.hh"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <numbers>
+#include <string_view>
+
+namespace esquema {
+    // Everything the global Environment starts out with. The table is
+    // fixed at compile time and the SymbolTable interns the names right
+    // after the keywords, so a builtin's Symbol id minus first_builtin
+    // is its index in here. That's a perfect hash for the price of a
+    // subtraction and a compare. The cells are made once per process
+    // and shared read only by every global Environment.
+    struct Builtin {
+        std::string_view name;
+        Native native;
+        double number;
+
+        // Same arguments, same answer, and nothing else happens.
+        // The Optimizer works these out ahead of time when it can.
+        // Anything that makes a new list isn't, eqv? could tell.
+        bool pure;
+    };
+
+    inline constexpr std::array builtins{
+        Builtin{"+", add, 0, true}, Builtin{"-", sub, 0, true},
+        Builtin{"*", mul, 0, true}, Builtin{"/", div, 0, true},
+        Builtin{"<", less, 0, true}, Builtin{"<=", less_equal, 0, true},
+        Builtin{">", greater, 0, true}, Builtin{">=", greater_equal, 0, true},
+        Builtin{"eqv?", equal, 0, true}, Builtin{"not", negate, 0, true},
+        Builtin{"cons", cons, 0, false}, Builtin{"car", car, 0, true},
+        Builtin{"cdr", cdr, 0, true}, Builtin{"list", list, 0, false},
+        Builtin{"length", length, 0, true},
+        Builtin{"pi", nullptr, std::numbers::pi, true},
+        Builtin{"e", nullptr, std::numbers::e, true},
+    };
+
+    inline constexpr std::uint32_t first_builtin = Symbol::NumKeywords;
+
+    // Where id is in the table, builtins.size() if it isn't there
+    constexpr std::size_t builtin_index(std::uint32_t id) noexcept {
+        auto index = static_cast<std::size_t>(id - first_builtin);
+        return id >= first_builtin && index < builtins.size() ? index : builtins.size();
+    }
+
+    // Two builtins with the same name would throw every id after
+    // them off by one, names are compared like the SymbolTable does
+    namespace detail {
+        constexpr bool builtin_names_distinct() noexcept {
+            auto fold = [] (char c) {
+                return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+            };
+
+            for (auto i = std::size_t{0}; i < builtins.size(); ++i) {
+                for (auto j = i + 1; j < builtins.size(); ++j) {
+                    auto lhs = builtins[i].name, rhs = builtins[j].name;
+                    auto same = lhs.size() == rhs.size();
+                    for (auto k = std::size_t{0}; same && k < lhs.size(); ++k) {
+                        same = fold(lhs[k]) == fold(rhs[k]);
+                    }
+
+                    if (same) {
+                        return false;
+                    }
+                }
+            }
+
+            return true;
+        }
+    }
+
+    static_assert(detail::builtin_names_distinct(), "Builtin names must be distinct");
+}
+
+#endif
@@ -0,0 +1,156 @@
+#include "closure.hh"
+#include "compiler.hh"
+#include "environ.hh"
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+    using namespace esquema;
+
+    // Anything that could hold on to the parameters or add to
+    // them, it doesn't matter how deep down it is
+    bool makes_scope(Cell const & cell) {
+        auto const * list = std::get_if<List>(&cell);
+        if (!list || list->empty()) {
+            return false;
+        }
+
+        if (auto const * head = std::get_if<Symbol>(&list->front())) {
+            if (head->id() == Symbol::Lambda || head->id() == Symbol::Define) {
+                return true;
+            }
+        }
+
+        return std::any_of(list->begin(), list->end(), makes_scope);
+    }
+}
+
+namespace esquema {
+    std::vector<Symbol> const & Function::params() const noexcept {
+        return m_params;
+    }
+
+    std::span<Cell const> Function::body() const noexcept {
+        return m_body;
+    }
+
+    bool Function::needs_scope() const noexcept {
+        return m_needs_scope;
+    }
+
+    Code const & Function::code() const {
+        if (!m_code) {
+            m_code = std::make_unique<Code>(Compiler{}.compile_function(*this));
+        }
+
+        return *m_code;
+    }
+
+    void Function::check_arity(std::size_t argc) const {
+        if (argc != m_params.size()) {
+            std::ostringstream msg{};
+            msg << "Wrong number of arguments: expected "
+                << m_params.size() << ", got " << argc;
+
+            throw std::runtime_error{msg.str()};
+        }
+    }
+
+    std::shared_ptr<Function const> Function::nested(List const & form) const noexcept {
+        for (auto const & [nested_form, function] : m_nested) {
+            if (nested_form == &form) {
+                return function;
+            }
+        }
+
+        return nullptr;
+    }
+
+    char const * Function::malformed(List const & form) noexcept {
+        if (form.size() < 3 || !form[1].is_list()) {
+            return "lambda requires a parameter list and a body";
+        }
+
+        auto const & params = std::get<List>(form[1]);
+        for (auto it = params.begin(); it != params.end(); ++it) {
+            auto same = [it] (Cell const & earlier) {
+                return std::get<Symbol>(earlier) == std::get<Symbol>(*it);
+            };
+
+            if (!it->is_symbol() || std::any_of(params.begin(), it, same)) {
+                return "lambda parameters must be distinct symbols";
+            }
+        }
+
+        return nullptr;
+    }
+
+    // Copying the form puts it on the regular heap, see List
+    Function::Function(List const & form)
+        : Function{std::make_shared<List const>(form)}
+    { }
+
+    Function::Function(List const & form, std::shared_ptr<List const> source)
+        : m_source{std::move(source)}, m_params{}
+        , m_body{form.data() + 2, form.size() - 2}
+        , m_needs_scope{std::any_of(m_body.begin(), m_body.end(), makes_scope)}
+        , m_nested{}, m_code{}
+    {
+        for (auto const & param : std::get<List>(form[1])) {
+            m_params.push_back(std::get<Symbol>(param));
+        }
+
+        for (auto const & cell : m_body) {
+            find_nested(cell);
+        }
+    }
+
+    Function::Function(std::shared_ptr<List const> const & source)
+        : Function{*source, source}
+    { }
+
+    // A lambda takes care of the ones inside it itself, and one
+    // that's malformed never gets made so it doesn't need a Function
+    void Function::find_nested(Cell const & cell) {
+        auto const * list = std::get_if<List>(&cell);
+        if (!list || list->empty()) {
+            return;
+        }
+
+        auto const * head = std::get_if<Symbol>(&list->front());
+        if (head && head->id() == Symbol::Lambda) {
+            if (!malformed(*list)) {
+                m_nested.emplace_back(list, std::make_shared<Function const>(*list, m_source));
+            }
+
+            return;
+        }
+
+        for (auto const & item : *list) {
+            find_nested(item);
+        }
+    }
+
+    Function::~Function() = default;
+
+    Function const & Closure::function() const noexcept {
+        return *m_function;
+    }
+
+    Environment * Closure::env() const noexcept {
+        return m_env;
+    }
+
+    void Closure::trace(Tracer & tracer) const {
+        tracer.mark(m_env);
+    }
+
+    std::size_t Closure::bytes() const noexcept {
+        return sizeof(Closure);
+    }
+
+    Closure::Closure(std::shared_ptr<Function const> function, Environment * env) noexcept
+        : Object{Kind::Closure}, m_function{std::move(function)}, m_env{env}
+    { }
+}
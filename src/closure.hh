@@ -0,0 +1,102 @@
+#ifndef ESQUEMA_CLOSURE_HH_INCLUDED
+#define ESQUEMA_CLOSURE_HH_INCLUDED
+
+#include "ast.hh"
+#include "heap.hh"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace esquema {
+    class Code;
+
+    // Everything a lambda expression says, its parameters and its
+    // body, copied out of the parse tree so it outlives the Parser.
+    // Every Closure made from the same expression shares one. The
+    // body is compiled the first time the VM calls it and the Code
+    // is kept for every call after that.
+    //
+    // Only the outermost lambda is copied. The Functions for the
+    // lambdas in its body are made along with it and point into the
+    // same copy, so evaluating an inner lambda over and over, in
+    // either engine, never copies its body again.
+    class Function {
+    // Interface
+    public:
+        std::vector<Symbol> const & params() const noexcept;
+        std::span<Cell const> body() const noexcept;
+
+        // A body that makes closures or defines variables needs the
+        // parameters in an Environment of its own on every call. One
+        // that doesn't can keep them on the VM's stack.
+        bool needs_scope() const noexcept;
+
+        Code const & code() const;
+
+        // Throws if argc isn't how many parameters there are
+        void check_arity(std::size_t argc) const;
+
+        // The Function for a lambda expression in our body, form has
+        // to be the very List in there. nullptr if it isn't one of ours.
+        std::shared_ptr<Function const> nested(List const & form) const noexcept;
+
+        // Why form isn't a lambda we can make, nullptr if it is
+        static char const * malformed(List const & form) noexcept;
+
+    // Constructors
+    public:
+        // form is a whole (lambda (params...) body...) that
+        // malformed had nothing to say about. The first one copies
+        // it, the second is for a form that's inside source already.
+        explicit Function(List const & form);
+        Function(List const & form, std::shared_ptr<List const> source);
+        ~Function();
+
+    // Helpers
+    private:
+        explicit Function(std::shared_ptr<List const> const & source);
+        void find_nested(Cell const & cell);
+
+    // Data
+    private:
+        // The copy of the outermost lambda, everything points into it
+        std::shared_ptr<List const> m_source;
+        std::vector<Symbol> m_params;
+        std::span<Cell const> m_body;
+        bool m_needs_scope;
+
+        // Hardly any body has more than a couple so a
+        // vector beats a map
+        std::vector<std::pair<List const *, std::shared_ptr<Function const>>> m_nested;
+        mutable std::unique_ptr<Code> m_code;
+    };
+
+    // A Function together with the Environment it was made in.
+    // Calling it binds the arguments to the parameters in a new
+    // Environment whose outer one is the Closure's and runs the body
+    // in there. Closures live on a Heap, which keeps the Environment
+    // alive for as long as the Closure is, and never change once
+    // they're made. Outside the Heap they're handed around as a Lambda.
+    class Closure : public Object {
+    // Interface
+    public:
+        Function const & function() const noexcept;
+        Environment * env() const noexcept;
+        void trace(Tracer & tracer) const override;
+        std::size_t bytes() const noexcept override;
+
+    // Constructors
+    public:
+        Closure(std::shared_ptr<Function const> function, Environment * env) noexcept;
+
+    // Data
+    private:
+        std::shared_ptr<Function const> m_function;
+        Environment * m_env;
+    };
+}
+
+#endif
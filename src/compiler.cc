@@ -0,0 +1,407 @@
+#include "compiler.hh"
+#include "builtins.hh"
+#include "optimizer.hh"
+#include <algorithm>
+#include <iomanip>
+#include <optional>
+#include <ostream>
+#include <utility>
+
+namespace {
+    using namespace esquema;
+
+    // Which instruction a call of head with two arguments gets, if
+    // it has one of its own. It's only the name, whatever it's bound
+    // to is checked when the instruction runs.
+    std::optional<Op> binary_op(Cell const & head) noexcept {
+        auto const * sym = std::get_if<Symbol>(&head);
+        auto const index = sym ? builtin_index(sym->id()) : builtins.size();
+        if (index == builtins.size()) {
+            return {};
+        }
+
+        auto const native = builtins[index].native;
+        if (native == esquema::add) return Op::Add;
+        if (native == esquema::sub) return Op::Sub;
+        if (native == esquema::mul) return Op::Mul;
+        if (native == esquema::div) return Op::Div;
+        if (native == esquema::less) return Op::Less;
+        if (native == esquema::less_equal) return Op::LessEqual;
+        if (native == esquema::greater) return Op::Greater;
+        if (native == esquema::greater_equal) return Op::GreaterEqual;
+        return {};
+    }
+}
+
+namespace esquema {
+    std::ostream & operator<<(std::ostream & ostr, Op op) {
+        switch (op) {
+            case Op::Const: ostr << "Const"; break;
+            case Op::Local: ostr << "Local"; break;
+            case Op::Global: ostr << "Global"; break;
+            case Op::Define: ostr << "Define"; break;
+            case Op::Pop: ostr << "Pop"; break;
+            case Op::Jump: ostr << "Jump"; break;
+            case Op::JumpIfFalse: ostr << "JumpIfFalse"; break;
+            case Op::MakeClosure: ostr << "MakeClosure"; break;
+            case Op::Call: ostr << "Call"; break;
+            case Op::TailCall: ostr << "TailCall"; break;
+            case Op::Raise: ostr << "Raise"; break;
+            case Op::Return: ostr << "Return"; break;
+            case Op::Fold: ostr << "Fold"; break;
+            case Op::Add: ostr << "Add"; break;
+            case Op::Sub: ostr << "Sub"; break;
+            case Op::Mul: ostr << "Mul"; break;
+            case Op::Div: ostr << "Div"; break;
+            case Op::Less: ostr << "Less"; break;
+            case Op::LessEqual: ostr << "LessEqual"; break;
+            case Op::Greater: ostr << "Greater"; break;
+            case Op::GreaterEqual: ostr << "GreaterEqual"; break;
+            default: ostr << "Unknown";
+        }
+
+        return ostr;
+    }
+
+    // A poor man's disassembler, handy when something goes sideways
+    std::ostream & operator<<(std::ostream & ostr, Code const & code) {
+        for (auto i = 0u; i < code.size(); ++i) {
+            auto const & instr = code.m_instrs[i];
+            ostr << std::setw(4) << std::setfill('0') << i << ' '
+                 << instr.op << ' ' << instr.arg;
+
+            switch (instr.op) {
+                case Op::Const:
+                    ostr << " ; " << code.constant(instr.arg);
+                    break;
+                case Op::Global: case Op::Define:
+                    ostr << " ; " << code.global(instr.arg).symbol;
+                    break;
+                case Op::Raise:
+                    ostr << " ; " << code.message(instr.arg);
+                    break;
+                case Op::Fold:
+                    ostr << " ; " << code.constant(code.fold(instr.arg).constant)
+                         << " until " << code.fold(instr.arg).end;
+                    break;
+                default:
+                    break;
+            }
+
+            ostr << '\n';
+        }
+
+        return ostr;
+    }
+
+    Instr const * Code::instrs() const noexcept {
+        return m_instrs.data();
+    }
+
+    Value Code::constant(std::uint32_t idx) const noexcept {
+        return m_consts[idx];
+    }
+
+    Value Code::constant(std::uint32_t idx, Heap & heap) const {
+        auto constant = m_consts[idx];
+        if (!constant.heap_object()) {
+            return constant;
+        }
+
+        if (m_loaded_heap != heap.id()) {
+            unpin_loaded();
+            m_loaded.assign(m_consts.size(), Value{});
+            m_loaded_heap = heap.id();
+        }
+
+        auto & loaded = m_loaded[idx];
+        if (!loaded.heap_object()) {
+            loaded = Value::from_cell(constant.to_cell(), heap);
+            pin(loaded);
+        }
+
+        return loaded;
+    }
+
+    std::string const & Code::message(std::uint32_t idx) const noexcept {
+        return m_messages[idx];
+    }
+
+    std::shared_ptr<Function const> const & Code::function(std::uint32_t idx) const noexcept {
+        return m_functions[idx];
+    }
+
+    GlobalRef & Code::global(std::uint32_t idx) const noexcept {
+        return m_globals[idx];
+    }
+
+    FoldRef & Code::fold(std::uint32_t idx) const noexcept {
+        return m_folds[idx];
+    }
+
+    std::uint32_t Code::size() const noexcept {
+        return static_cast<std::uint32_t>(m_instrs.size());
+    }
+
+    std::uint32_t Code::emit(Op op, std::uint32_t arg) {
+        m_instrs.push_back(Instr{op, arg});
+        return size() - 1;
+    }
+
+    void Code::patch(std::uint32_t at, std::uint32_t arg) noexcept {
+        m_instrs[at].arg = arg;
+    }
+
+    std::uint32_t Code::add_constant(Cell const & cell) {
+        m_consts.push_back(Value::from_cell(cell, m_heap));
+        return static_cast<std::uint32_t>(m_consts.size() - 1);
+    }
+
+    std::uint32_t Code::add_global(Symbol const & symbol) {
+        auto next = static_cast<std::uint32_t>(m_globals.size());
+        auto [it, inserted] = m_global_index.try_emplace(symbol, next);
+        if (inserted) {
+            m_globals.push_back(GlobalRef{symbol, 0, nullptr, 0, false});
+        }
+
+        return it->second;
+    }
+
+    std::uint32_t Code::add_fold(Cell const & value, std::uint64_t guard) {
+        m_folds.push_back(FoldRef{add_constant(value), 0, guard, 0, false});
+        return static_cast<std::uint32_t>(m_folds.size() - 1);
+    }
+
+    // The copies are pinned by whoever holds them
+    Code::Code(Code && other) noexcept
+        : m_instrs{std::move(other.m_instrs)}, m_consts{std::move(other.m_consts)}
+        , m_messages{std::move(other.m_messages)}, m_functions{std::move(other.m_functions)}
+        , m_globals{std::move(other.m_globals)}, m_folds{std::move(other.m_folds)}
+        , m_global_index{std::move(other.m_global_index)}, m_heap{std::move(other.m_heap)}
+        , m_loaded{std::exchange(other.m_loaded, {})}
+        , m_loaded_heap{std::exchange(other.m_loaded_heap, 0)}
+    { }
+
+    Code & Code::operator=(Code && other) noexcept {
+        if (this == &other) {
+            return *this;
+        }
+
+        unpin_loaded();
+        m_instrs = std::move(other.m_instrs);
+        m_consts = std::move(other.m_consts);
+        m_messages = std::move(other.m_messages);
+        m_functions = std::move(other.m_functions);
+        m_globals = std::move(other.m_globals);
+        m_folds = std::move(other.m_folds);
+        m_global_index = std::move(other.m_global_index);
+        m_heap = std::move(other.m_heap);
+        m_loaded = std::exchange(other.m_loaded, {});
+        m_loaded_heap = std::exchange(other.m_loaded_heap, 0);
+        return *this;
+    }
+
+    Code::~Code() {
+        unpin_loaded();
+    }
+
+    void Code::unpin_loaded() const noexcept {
+        for (auto value : m_loaded) {
+            unpin(value);
+        }
+
+        m_loaded.clear();
+        m_loaded_heap = 0;
+    }
+
+    std::uint32_t Code::add_message(std::string msg) {
+        m_messages.push_back(std::move(msg));
+        return static_cast<std::uint32_t>(m_messages.size() - 1);
+    }
+
+    std::uint32_t Code::add_function(std::shared_ptr<Function const> function) {
+        m_functions.push_back(std::move(function));
+        return static_cast<std::uint32_t>(m_functions.size() - 1);
+    }
+
+    Code Compiler::compile(Cell const & cell) {
+        m_code = Code{};
+        m_locals = nullptr;
+        m_function = nullptr;
+        compile_cell(cell);
+        m_code.emit(Op::Return);
+        return std::exchange(m_code, Code{});
+    }
+
+    Code Compiler::compile_all(List const & forms) {
+        m_code = Code{};
+        m_locals = nullptr;
+        m_function = nullptr;
+        compile_body(forms);
+        m_code.emit(Op::Return);
+        return std::exchange(m_code, Code{});
+    }
+
+    Code Compiler::compile_function(Function const & function) {
+        m_code = Code{};
+        m_locals = function.needs_scope() ? nullptr : &function.params();
+        m_function = &function;
+        compile_body(function.body(), true);
+        m_code.emit(Op::Return);
+        m_locals = nullptr;
+        m_function = nullptr;
+        return std::exchange(m_code, Code{});
+    }
+
+    void Compiler::compile_cell(Cell const & cell, bool tail) {
+        if (cell.is_symbol()) {
+            auto const & sym = std::get<Symbol>(cell);
+            if (m_locals) {
+                auto it = std::find(m_locals->begin(), m_locals->end(), sym);
+                if (it != m_locals->end()) {
+                    m_code.emit(Op::Local, static_cast<std::uint32_t>(it - m_locals->begin()));
+                    return;
+                }
+            }
+
+            m_code.emit(Op::Global, m_code.add_global(sym));
+        }
+
+        else if (cell.is_list()) {
+            compile_list(std::get<List>(cell), tail);
+        }
+
+        // Everything else evaluates to itself
+        else {
+            m_code.emit(Op::Const, m_code.add_constant(cell));
+        }
+    }
+
+    void Compiler::compile_list(List const & list, bool tail) {
+        // The empty list evaluates to itself
+        if (list.empty()) {
+            m_code.emit(Op::Const, m_code.add_constant(list));
+            return;
+        }
+
+        auto const & head = list.front();
+        if (head.is_symbol()) {
+            switch (std::get<Symbol>(head).id()) {
+                case Symbol::Define: return compile_define(list);
+                case Symbol::If: return compile_if(list, tail);
+                case Symbol::Begin: return compile_begin(list, tail);
+                case Symbol::Lambda: return compile_lambda(list);
+                case Symbol::Folded:
+                    if (list.size() == 4) {
+                        return compile_fold(list, tail);
+                    }
+                    break;
+                default: break;
+            }
+        }
+
+        compile_call(list, tail);
+    }
+
+    void Compiler::compile_define(List const & list) {
+        if (list.size() != 3) {
+            return raise("define requires two arguments");
+        }
+
+        auto it = ++list.begin();
+        auto const & var = *it++;
+        if (!var.is_symbol()) {
+            return raise("define requires a symbol to bind to");
+        }
+
+        compile_cell(*it);
+        m_code.emit(Op::Define, m_code.add_global(std::get<Symbol>(var)));
+    }
+
+    void Compiler::compile_if(List const & list, bool tail) {
+        if (list.size() < 3) {
+            return raise("if requires either two or three arguments");
+        }
+
+        auto it = ++list.begin();
+        compile_cell(*it++);
+        auto to_false = m_code.emit(Op::JumpIfFalse);
+        compile_cell(*it++, tail);
+        auto to_end = m_code.emit(Op::Jump);
+        m_code.patch(to_false, m_code.size());
+        if (list.size() == 4) {
+            compile_cell(*it, tail);
+        }
+
+        else {
+            m_code.emit(Op::Const, m_code.add_constant(Nil{}));
+        }
+
+        m_code.patch(to_end, m_code.size());
+    }
+
+    void Compiler::compile_begin(List const & list, bool tail) {
+        compile_body(std::span<Cell const>{list}.subspan(1), tail);
+    }
+
+    // Only the last value sticks around, an empty body is Nil
+    void Compiler::compile_body(std::span<Cell const> forms, bool tail) {
+        if (forms.empty()) {
+            m_code.emit(Op::Const, m_code.add_constant(Nil{}));
+            return;
+        }
+
+        for (auto const & form : forms.first(forms.size() - 1)) {
+            compile_cell(form);
+            m_code.emit(Op::Pop);
+        }
+
+        compile_cell(forms.back(), tail);
+    }
+
+    // The body isn't compiled here, it waits for the first call
+    void Compiler::compile_lambda(List const & list) {
+        if (auto msg = Function::malformed(list)) {
+            return raise(msg);
+        }
+
+        // Made along with the Function we're in, if we're in one
+        auto function = m_function ? m_function->nested(list) : nullptr;
+        if (!function) {
+            function = std::make_shared<Function const>(list);
+        }
+
+        m_code.emit(Op::MakeClosure, m_code.add_function(std::move(function)));
+    }
+
+    // Only a lambda's body has a frame to hand over, anywhere
+    // else a call in tail position is just a call
+    void Compiler::compile_call(List const & list, bool tail) {
+        for (auto const & cell : list) {
+            compile_cell(cell);
+        }
+
+        auto const tail_call = tail && m_function;
+        if (auto op = list.size() == 3 ? binary_op(list.front()) : std::nullopt) {
+            m_code.emit(*op, tail_call ? 1 : 0);
+            return;
+        }
+
+        auto op = tail_call ? Op::TailCall : Op::Call;
+        m_code.emit(op, static_cast<std::uint32_t>(list.size() - 1));
+    }
+
+    // The original comes right after the Fold, when the fold holds
+    // it's jumped over
+    void Compiler::compile_fold(List const & list, bool tail) {
+        auto const guard = static_cast<std::uint64_t>(std::get<Number>(list[3]).exact());
+        auto idx = m_code.add_fold(list[1], guard);
+        m_code.emit(Op::Fold, idx);
+        compile_cell(list[2], tail);
+        m_code.fold(idx).end = m_code.size();
+    }
+
+    void Compiler::raise(std::string msg) {
+        m_code.emit(Op::Raise, m_code.add_message(std::move(msg)));
+    }
+}
@@ -0,0 +1,198 @@
+#ifndef ESQUEMA_COMPILER_HH_INCLUDED
+#define ESQUEMA_COMPILER_HH_INCLUDED
+
+#include "ast.hh"
+#include "closure.hh"
+#include "heap.hh"
+#include "value.hh"
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace esquema {
+    // The instruction set of the VM. It's a plain stack machine
+    // so most instructions push or pop the value stack. The
+    // meaning of the argument depends on the instruction and is
+    // noted next to each one.
+    enum class Op : std::uint8_t {
+        Const,          // push constant[arg]
+        Local,          // push parameter arg of the lambda that's running
+        Global,         // push the value bound to global[arg]
+        Define,         // bind global[arg] to the top value and replace it with Nil
+        Pop,            // throw away the top value
+        Jump,           // continue at instruction arg
+        JumpIfFalse,    // pop a Bool and continue at instruction arg if it is #f
+        MakeClosure,    // push a closure over function[arg] and the current Environment
+        Call,           // call the proc sitting under arg arguments
+        TailCall,       // the same but a lambda takes over the running lambda's frame
+        Raise,          // throw a runtime_error with message[arg]
+        Return,         // pop the top value and hand it back
+        Fold,           // if fold[arg] holds push its constant and continue at its end
+
+        // A call with two arguments whose head names one of these
+        // builtins. If the callee really is that builtin and both
+        // arguments are fixnums or doubles the answer is worked out
+        // right here, see fast::add and friends. Otherwise it's Call 2,
+        // or TailCall 2 when arg is 1.
+        Add, Sub, Mul, Div, Less, LessEqual, Greater, GreaterEqual
+    };
+
+    std::ostream & operator<<(std::ostream & ostr, Op op);
+
+    // One instruction, the argument is an index or a count
+    // depending on the opcode.
+    struct Instr {
+        Op op;
+        std::uint32_t arg;
+    };
+
+    // A variable the Code refers to, the inline cache for every
+    // place the Code uses it. The first lookup caches the slot it
+    // found, the id of the Environment the slot is in and how many
+    // Environments out from the one the Code ran in that was. From
+    // then on it's a pointer away, no hashing, for as long as that
+    // Environment still has that id and none of the ones in between
+    // may have bound the name since, see Environment::may_bind.
+    // A shared slot belongs to the builtins and is only ever read.
+    struct GlobalRef {
+        Symbol symbol;
+        std::uint64_t env_id;
+        Value * slot;
+        std::uint32_t depth;
+        bool shared;
+    };
+
+    // A form the Optimizer folded. What the original evaluates to
+    // is constant[constant] for as long as the builtins in guard are
+    // still the builtins. Whether they are is worked out once per
+    // Environment, like a GlobalRef, and when they aren't the code
+    // for the original that follows the Fold runs instead.
+    struct FoldRef {
+        std::uint32_t constant;
+        std::uint32_t end;
+        std::uint64_t guard;
+        std::uint64_t env_id;
+        bool holds;
+    };
+
+    // Code is what the Compiler hands to the VM. It owns the
+    // instructions along with the constants and error messages
+    // they refer to, so it can be run as many times as you like
+    // once it has been compiled. Constants are converted to Values
+    // up front and anything they point to lives on the Code's heap,
+    // the VM gets copies on its own before anybody can keep them.
+    class Code {
+    // Friends
+    public:
+        friend std::ostream & operator<<(std::ostream & ostr, Code const & code);
+
+    // Interface
+    public:
+        Instr const * instrs() const noexcept;
+        Value constant(std::uint32_t idx) const noexcept;
+
+        // The constant as it is on heap. One that lives on ours is
+        // copied over the first time and the copy is pinned until we
+        // go or get asked with another Heap, so a bignum literal in a
+        // loop isn't made again every time around.
+        Value constant(std::uint32_t idx, Heap & heap) const;
+        std::string const & message(std::uint32_t idx) const noexcept;
+        std::shared_ptr<Function const> const & function(std::uint32_t idx) const noexcept;
+        std::uint32_t size() const noexcept;
+
+        // The cache is filled in while the Code runs, so running the
+        // same Code on two threads at once is out
+        GlobalRef & global(std::uint32_t idx) const noexcept;
+        FoldRef & fold(std::uint32_t idx) const noexcept;
+
+    // Building interface, this is what the Compiler uses
+    public:
+        std::uint32_t emit(Op op, std::uint32_t arg = 0);
+        void patch(std::uint32_t at, std::uint32_t arg) noexcept;
+        std::uint32_t add_constant(Cell const & cell);
+        std::uint32_t add_message(std::string msg);
+        std::uint32_t add_function(std::shared_ptr<Function const> function);
+
+        // Each symbol gets one entry however often it's used
+        std::uint32_t add_global(Symbol const & symbol);
+
+        // The end is patched in once the original has been compiled
+        std::uint32_t add_fold(Cell const & value, std::uint64_t guard);
+
+    // Constructors
+    public:
+        Code() = default;
+        Code(Code && other) noexcept;
+        Code & operator=(Code && other) noexcept;
+        ~Code();
+
+    // Helpers
+    private:
+        void unpin_loaded() const noexcept;
+
+    // Data
+    private:
+        std::vector<Instr> m_instrs;
+        std::vector<Value> m_consts;
+        std::vector<std::string> m_messages;
+        std::vector<std::shared_ptr<Function const>> m_functions;
+        mutable std::vector<GlobalRef> m_globals;
+        mutable std::vector<FoldRef> m_folds;
+        std::unordered_map<Symbol, std::uint32_t> m_global_index;
+        Heap m_heap;
+
+        // The copies constant has made, on the Heap with this id
+        mutable std::vector<Value> m_loaded;
+        mutable std::uint64_t m_loaded_heap = 0;
+    };
+
+    // The Compiler lowers a parsed Cell into Code. All the special
+    // form dispatch happens here, once, instead of every time the
+    // expression gets evaluated. Malformed special forms don't throw
+    // at compile time, they compile to a Raise so that errors show
+    // up at the same moment the tree walker would report them.
+    // A lambda's body is compiled on its own, the first time it's
+    // called, and calls in tail position in there become TailCalls.
+    class Compiler {
+    // Interface
+    public:
+        Code compile(Cell const & cell);
+
+        // A whole program, the forms run in order like the body
+        // of a begin and the last one's value is the result
+        Code compile_all(List const & forms);
+
+        // The body of a lambda, see Function
+        Code compile_function(Function const & function);
+
+    // Helpers
+    private:
+        void compile_cell(Cell const & cell, bool tail = false);
+        void compile_body(std::span<Cell const> forms, bool tail = false);
+        void compile_list(List const & list, bool tail);
+        void compile_define(List const & list);
+        void compile_if(List const & list, bool tail);
+        void compile_begin(List const & list, bool tail);
+        void compile_lambda(List const & list);
+        void compile_call(List const & list, bool tail);
+        void compile_fold(List const & list, bool tail);
+        void raise(std::string msg);
+
+    // Data
+    private:
+        Code m_code;
+
+        // The parameters when they're on the stack, nullptr when
+        // they're in an Environment or there aren't any
+        std::vector<Symbol> const * m_locals = nullptr;
+
+        // The Function whose body we're compiling, if any
+        Function const * m_function = nullptr;
+    };
+}
+
+#endif
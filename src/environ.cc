@@ -1,67 +1,280 @@
 #include "environ.hh"
-#include "native_proc.hh"
-#include <numbers>
+#include "builtins.hh"
+#include "intern.hh"
+#include <atomic>
+#include <utility>
 
 namespace {
-    using namespace esquema::literals::ci_string_literals;
+    using namespace esquema;
+
+    std::uint64_t name_bit(Symbol const & sym) noexcept {
+        return std::uint64_t{1} << (sym.id() % 64);
+    }
+
+    std::uint64_t next_id() noexcept {
+        static std::atomic<std::uint64_t> ids{1};
+        return ids.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Made the first time anybody asks and never touched again. They
+    // go in in table order so the ids come out the same as interning.
+    // None of them are on a Heap so there's nothing to pin.
+    SymbolMap<Value> const & shared_builtins() {
+        static SymbolMap<Value> const values = [] {
+            SymbolMap<Value> values{};
+            for (auto const & builtin : builtins) {
+                auto value = builtin.native ? Value{builtin.native} : Value{Number{builtin.number}};
+                values.try_emplace(Symbol{builtin.name}, value);
+            }
+
+            return values;
+        }();
+
+        return values;
+    }
 }
 
 namespace esquema {
-    // The global environment in all its glory
+    // The global environment in all its glory, all it takes
+    // is a flag since the builtins are already made
     Environment Environment::make_global() {
         auto env = Environment{};
-        env.m_inner = {{
-            { "+"_cis, add }, { "-"_cis, sub }, 
-            { "*"_cis, mul }, { "/"_cis, div },
-            { "<"_cis, less }, { "<="_cis, less_equal }, 
-            { ">"_cis, greater }, { ">="_cis, greater_equal },
-            { "eqv?"_cis, equal }, { "not"_cis, negate }, 
-            { "pi"_cis, Cell{Number{std::numbers::pi}} },
-            { "e"_cis, Cell{Number{std::numbers::e}} },
-        }};
-
+        env.m_builtins = true;
         return env;
     }
 
-    Environment::iterator Environment::begin() noexcept {
-        return m_inner.begin();
+    Environment::const_iterator::const_iterator(
+        Environment const * env,
+        container_type::const_iterator shared,
+        container_type::const_iterator own
+    ) noexcept
+        : m_env{env}, m_shared{shared}, m_own{own}
+    { }
+
+    Environment::const_iterator::reference Environment::const_iterator::operator*() const noexcept {
+        return in_builtins() ? *m_shared : *m_own;
+    }
+
+    Environment::const_iterator::pointer Environment::const_iterator::operator->() const noexcept {
+        return &**this;
     }
 
-    Environment::iterator Environment::end() noexcept {
-        return m_inner.end();
+    Environment::const_iterator & Environment::const_iterator::operator++() noexcept {
+        if (in_builtins()) {
+            ++m_shared;
+            skip_hidden();
+        }
+
+        else {
+            ++m_own;
+        }
+
+        return *this;
     }
 
+    Environment::const_iterator Environment::const_iterator::operator++(int) noexcept {
+        auto old = *this;
+        ++*this;
+        return old;
+    }
+
+    bool Environment::const_iterator::in_builtins() const noexcept {
+        return m_shared != shared_builtins().end();
+    }
+
+    void Environment::const_iterator::skip_hidden() noexcept {
+        while (in_builtins() && (m_env->m_names & name_bit(m_shared->first))
+               && m_env->m_inner.find(m_shared->first) != m_env->m_inner.end()) {
+            ++m_shared;
+        }
+    }
+
+    // Anything but a global Environment starts out past the builtins
     Environment::const_iterator Environment::begin() const noexcept {
-        return m_inner.begin();
+        auto const & shared = shared_builtins();
+        auto it = const_iterator{this, m_builtins ? shared.begin() : shared.end(), m_inner.begin()};
+        it.skip_hidden();
+        return it;
     }
 
     Environment::const_iterator Environment::end() const noexcept {
-        return m_inner.end();
+        return const_iterator{this, shared_builtins().end(), m_inner.end()};
     }
 
+    // Found further out, it's an iterator of the Environment that binds
+    // it, which is never equal to our end
     Environment::const_iterator Environment::find(Symbol const & sym) const noexcept {
-        return find(sym.value());
+        auto const & shared = shared_builtins();
+        auto it = (m_names & name_bit(sym)) ? m_inner.find(sym) : m_inner.end();
+        if (it != m_inner.end()) {
+            return const_iterator{this, shared.end(), it};
+        }
+
+        if (m_builtins && builtin_index(sym.id()) != builtins.size()) {
+            return const_iterator{this, shared.find(sym), m_inner.begin()};
+        }
+
+        if (m_outer) {
+            auto outer = m_outer->find(sym);
+            if (outer != m_outer->end()) {
+                return outer;
+            }
+        }
+
+        return end();
     }
 
+    // A name that was never interned can't have been bound
     Environment::const_iterator Environment::find(CIString const & name) const noexcept {
-        auto it = m_inner.find(name);
-        if (it == std::end(m_inner) && m_outer) {
-            it = m_outer->find(name);
+        auto id = SymbolTable::global().find(name);
+        if (!id) {
+            return end();
         }
 
-        return it;
+        return find(Symbol::from_id(*id));
     }
 
-    Environment::iterator Environment::insert(Symbol const & sym, Cell const & cell) {
-        auto [it, inserted] = m_inner.insert({sym.value(), cell});
+    // Code that cached the shared value of a builtin we're about
+    // to hide has to look again, a new id makes sure it does
+    Environment::iterator Environment::insert(Symbol const & sym, Value value) {
+        auto [it, inserted] = m_inner.try_emplace(sym, value);
         if (!inserted) {
-            it->second = cell;
+            assign(it->second, value);
+            return const_iterator{this, shared_builtins().end(), it};
         }
 
-        return it;
+        if (!managed()) {
+            esquema::pin(value);
+        }
+
+        m_names |= name_bit(sym);
+        if (m_builtins && builtin_index(sym.id()) != builtins.size()) {
+            m_id = next_id();
+        }
+
+        return const_iterator{this, shared_builtins().end(), it};
+    }
+
+    Value * Environment::slot(Symbol const & sym) noexcept {
+        if (!(m_names & name_bit(sym))) {
+            return nullptr;
+        }
+
+        auto it = m_inner.find(sym);
+        return it == m_inner.end() ? nullptr : &it->second;
+    }
+
+    // The new value is pinned first in case it's the old one
+    void Environment::assign(Value & slot, Value value) noexcept {
+        if (!managed()) {
+            esquema::pin(value);
+            esquema::unpin(slot);
+        }
+
+        slot = value;
+    }
+
+    // The builtins are bound in a global Environment too
+    bool Environment::may_bind(Symbol const & sym) const noexcept {
+        return m_builtins || (m_names & name_bit(sym));
+    }
+
+    Environment * Environment::outer() const noexcept {
+        return m_outer;
+    }
+
+    Value const * Environment::builtin(Symbol const & sym) const noexcept {
+        if (!m_builtins || builtin_index(sym.id()) == builtins.size()
+            || ((m_names & name_bit(sym)) && m_inner.find(sym) != m_inner.end())) {
+            return nullptr;
+        }
+
+        return &shared_builtins().find(sym)->second;
+    }
+
+    std::uint64_t Environment::id() const noexcept {
+        return m_id;
+    }
+
+    void Environment::trace(Tracer & tracer) const {
+        for (auto const & [sym, value] : m_inner) {
+            tracer.mark(value);
+        }
+
+        tracer.mark(m_outer);
+    }
+
+    std::size_t Environment::bytes() const noexcept {
+        return sizeof(Environment) + m_inner.size() * sizeof(container_type::value_type);
     }
 
     Environment::Environment(Environment * outer)
-        : m_inner{}, m_outer{outer}
+        : Object{Kind::Environment}, m_inner{}, m_outer{outer}
+        , m_id{next_id()}, m_names{0}, m_builtins{false}
     { }
+
+    // A copy has values of its own so it can't share the id.
+    // It isn't on a Heap either so it pins them.
+    Environment::Environment(Environment const & other)
+        : Object{other}, m_inner{other.m_inner}, m_outer{other.m_outer}
+        , m_id{next_id()}, m_names{other.m_names}, m_builtins{other.m_builtins}
+    {
+        pin_all();
+    }
+
+    // The entries move along with the map so the id goes with them
+    // and whatever is left behind is a different Environment
+    Environment::Environment(Environment && other) noexcept
+        : Object{other}, m_inner{std::move(other.m_inner)}, m_outer{other.m_outer}
+        , m_id{std::exchange(other.m_id, next_id())}
+        , m_names{other.m_names}, m_builtins{other.m_builtins}
+    {
+        if (other.managed()) {
+            pin_all();
+        }
+    }
+
+    Environment & Environment::operator=(Environment const & other) {
+        auto copy = other;
+        return *this = std::move(copy);
+    }
+
+    Environment & Environment::operator=(Environment && other) noexcept {
+        if (this == &other) {
+            return *this;
+        }
+
+        if (!managed()) {
+            unpin_all();
+        }
+
+        m_inner = std::move(other.m_inner);
+        m_outer = other.m_outer;
+        m_id = std::exchange(other.m_id, next_id());
+        m_names = other.m_names;
+        m_builtins = other.m_builtins;
+        if (managed() != other.managed()) {
+            managed() ? unpin_all() : pin_all();
+        }
+
+        return *this;
+    }
+
+    Environment::~Environment() {
+        if (!managed()) {
+            unpin_all();
+        }
+    }
+
+    void Environment::pin_all() noexcept {
+        for (auto const & [sym, value] : m_inner) {
+            esquema::pin(value);
+        }
+    }
+
+    void Environment::unpin_all() noexcept {
+        for (auto const & [sym, value] : m_inner) {
+            esquema::unpin(value);
+        }
+    }
 }
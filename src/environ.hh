@@ -2,28 +2,35 @@
 #define ESQUEMA_ENVIRON_HH_INCLUDED
 
 #include "ast.hh"
-#include <unordered_map>
+#include "flat_map.hh"
+#include "heap.hh"
+#include "value.hh"
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
 
 namespace esquema {
     // The Environment holds Symbols that have been
     // bound to a value. A user can add further bindings.
     // Esquema also provides a default global environment
-    // with mathmatical constants and operations. The Environment
+    // with mathmatical constants and operations. Those live in
+    // one table every global environment shares, only what the
+    // user defines goes in the environment itself. The Environment
     // keeps a non-owning pointer to its parent environment
     // and if it can't find a symbol it searches each enclosing
     // environment until it hits the top or finds the symbol.
 
-    // TODO - All this is wildly inefficient. Everything
-    // is passed by copy and this will break down with
-    // closures, list, and procedures. To support all
-    // that GC must be implemented.
-    class Environment {
+    // Bindings are Values, so looking up a list hands back the
+    // Value pointing at it and nothing gets copied. The Environments
+    // a closure call makes for its parameters live on a Heap like the
+    // closures do and the collector takes care of them, cycles and
+    // all. The global one is owned by whoever made it. It pins what
+    // it's bound to, so whatever Heap made it can't take it away.
+    class Environment : public Object {
     // Save myself some typing but the user doesn't need
     // this so keep it private
     private:
-        using container_type = std::unordered_map<
-            CIString, Cell
-        >;
+        using container_type = SymbolMap<Value>;
 
     // Interface
     public:
@@ -31,11 +38,48 @@ namespace esquema {
 
     // Iterator interface
     public:
-        using iterator = container_type::iterator;
-        iterator begin() noexcept;
-        iterator end() noexcept;
+        // A global Environment goes over the builtins it doesn't hide
+        // first and then its own bindings, so iterating it still shows
+        // everything that's bound in it. The builtins are shared and
+        // read only, so the bindings are too, rebinding goes through
+        // assign.
+        class const_iterator {
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = container_type::value_type;
+            using difference_type = std::ptrdiff_t;
+            using pointer = value_type const *;
+            using reference = value_type const &;
 
-        using const_iterator = container_type::const_iterator;
+            reference operator*() const noexcept;
+            pointer operator->() const noexcept;
+            const_iterator & operator++() noexcept;
+            const_iterator operator++(int) noexcept;
+
+            // Iterators from different Environments are never equal
+            friend bool operator==(const_iterator const &, const_iterator const &) = default;
+
+            const_iterator() = default;
+
+        private:
+            friend class Environment;
+            const_iterator(
+                Environment const * env,
+                container_type::const_iterator shared,
+                container_type::const_iterator own
+            ) noexcept;
+
+            bool in_builtins() const noexcept;
+
+            // Steps over the builtins env has bound over
+            void skip_hidden() noexcept;
+
+            Environment const * m_env = nullptr;
+            container_type::const_iterator m_shared;
+            container_type::const_iterator m_own;
+        };
+
+        using iterator = const_iterator;
         const_iterator begin() const noexcept;
         const_iterator end() const noexcept;
 
@@ -47,22 +91,64 @@ namespace esquema {
         // Care must be taken with this as it can prevent the lookup
         // of symbols in enclonsing Environments if they have the
         // same name. That may well be desired, but be warned.
-        iterator insert(Symbol const & symbol, Cell const & cell);
+        iterator insert(Symbol const & symbol, Value value);
+
+        // The value bound to symbol in this Environment only, the
+        // enclosing ones aren't searched. Bindings are never removed
+        // and the map's entries don't move, so the pointer is good for
+        // as long as the Environment is. Rebinding goes through assign.
+        Value * slot(Symbol const & symbol) noexcept;
+        void assign(Value & slot, Value value) noexcept;
+
+        // False if symbol is certainly not bound in this Environment,
+        // true if it might be. It's a look at one bit, no hashing, so
+        // lookups can go straight past scopes that don't bind a name.
+        bool may_bind(Symbol const & symbol) const noexcept;
+        Environment * outer() const noexcept;
+
+        // The shared builtin bound to symbol if this is a global
+        // Environment and nothing here hides it. It's never written,
+        // defining the same name binds it here and changes the id.
+        Value const * builtin(Symbol const & symbol) const noexcept;
+
+        // Every Environment gets its own id, copies get a new one.
+        // Compiled code uses it to tell whether the slots it has
+        // cached belong to the Environment it's running against.
+        std::uint64_t id() const noexcept;
+
+        void trace(Tracer & tracer) const override;
+        std::size_t bytes() const noexcept override;
 
     // Constructor
     public:
         explicit Environment(Environment * outer = nullptr);
+        Environment(Environment const & other);
+        Environment(Environment && other) noexcept;
+        Environment & operator=(Environment const & other);
+        Environment & operator=(Environment && other) noexcept;
+        ~Environment() override;
+
+    // Helpers
+    private:
+        void pin_all() noexcept;
+        void unpin_all() noexcept;
 
     /// Data
     private:
-        // Just in case we've forgotten, this is an unordered_map
-        // with string keys and Cell values.
+        // Just in case we've forgotten, this is a flat SymbolMap
+        // with interned Symbol keys and Value values, so hashing a
+        // key is just reading its id and the values never move.
         container_type m_inner;
 
-        // This is a non-owning pointer for now. It may make
-        // sense to turn this into a shared_ptr or something
-        // else more exotic when closures are a thing.
+        // If we're on a Heap so is this, or it's the global one,
+        // and the collector traces through it either way
         Environment * m_outer;
+        std::uint64_t m_id;
+
+        // A bit for every name bound in here, by id modulo 64.
+        // Bindings are never removed so bits are never cleared.
+        std::uint64_t m_names;
+        bool m_builtins;
     };
 }
 
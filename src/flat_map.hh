@@ -0,0 +1,288 @@
+#ifndef ESQUEMA_FLAT_MAP_HH_INCLUDED
+#define ESQUEMA_FLAT_MAP_HH_INCLUDED
+
+#include "ast.hh"
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <new>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace esquema {
+    // A map from Symbols to T with open addressing. The table is a
+    // flat array of small slots, each holding the symbol's id, which
+    // doubles as its hash, and the index of the entry it belongs to.
+    // A lookup is a multiply, a shift and a walk over adjacent slots
+    // comparing integers, the entry itself is only touched on a hit.
+    // Names were case folded once when they were interned so there's
+    // no string hashing or comparing in here at all.
+    //
+    // The entries are kept in insertion order in fixed size chunks,
+    // that's what you iterate over. They never move, growing the table
+    // only rebuilds the slots, so pointers to the values are good for
+    // as long as the map is. An iterator is just the map and an index.
+    // There's no erase, nobody has needed it.
+    template <typename T>
+    class SymbolMap {
+    public:
+        using value_type = std::pair<Symbol const, T>;
+
+    // Iterator interface
+    private:
+        template <bool Const>
+        class basic_iterator {
+        public:
+            using map_type = std::conditional_t<Const, SymbolMap const, SymbolMap>;
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = SymbolMap::value_type;
+            using difference_type = std::ptrdiff_t;
+            using pointer = std::conditional_t<Const, value_type const, value_type> *;
+            using reference = std::conditional_t<Const, value_type const, value_type> &;
+
+            reference operator*() const noexcept { return m_map->entry(m_index); }
+            pointer operator->() const noexcept { return &m_map->entry(m_index); }
+
+            basic_iterator & operator++() noexcept {
+                ++m_index;
+                return *this;
+            }
+
+            basic_iterator operator++(int) noexcept {
+                auto old = *this;
+                ++m_index;
+                return old;
+            }
+
+            friend bool operator==(basic_iterator const &, basic_iterator const &) = default;
+
+            basic_iterator() = default;
+            basic_iterator(map_type * map, std::uint32_t index) noexcept
+                : m_map{map}, m_index{index}
+            { }
+
+            // An iterator goes to a const_iterator but not back
+            template <bool C = Const> requires C
+            basic_iterator(basic_iterator<false> const & other) noexcept
+                : m_map{other.m_map}, m_index{other.m_index}
+            { }
+
+        private:
+            friend class basic_iterator<true>;
+
+            map_type * m_map = nullptr;
+            std::uint32_t m_index = 0;
+        };
+
+    public:
+        using iterator = basic_iterator<false>;
+        using const_iterator = basic_iterator<true>;
+
+        iterator begin() noexcept { return {this, 0}; }
+        iterator end() noexcept { return {this, m_size}; }
+        const_iterator begin() const noexcept { return {this, 0}; }
+        const_iterator end() const noexcept { return {this, m_size}; }
+
+    // Interface
+    public:
+        iterator find(Symbol const & key) noexcept {
+            auto index = lookup(key.id());
+            return index == no_entry ? end() : iterator{this, index};
+        }
+
+        const_iterator find(Symbol const & key) const noexcept {
+            auto index = lookup(key.id());
+            return index == no_entry ? end() : const_iterator{this, index};
+        }
+
+        // Like the standard one, nothing happens if key is there
+        template <typename... Args>
+        std::pair<iterator, bool> try_emplace(Symbol const & key, Args &&... args) {
+            if (auto index = lookup(key.id()); index != no_entry) {
+                return {iterator{this, index}, false};
+            }
+
+            if ((m_size + 1) * 2 > m_slots.size()) {
+                rehash(std::max<std::size_t>(16, m_slots.size() * 2));
+            }
+
+            auto index = m_size;
+            emplace_back(key, std::forward<Args>(args)...);
+            place(Slot{key.id(), index});
+            return {iterator{this, index}, true};
+        }
+
+        std::pair<iterator, bool> insert_or_assign(Symbol const & key, T const & value) {
+            auto result = try_emplace(key, value);
+            if (!result.second) {
+                result.first->second = value;
+            }
+
+            return result;
+        }
+
+        std::size_t size() const noexcept { return m_size; }
+        bool empty() const noexcept { return m_size == 0; }
+
+    // Constructors
+    public:
+        SymbolMap() = default;
+
+        // The chunks are what hold the entries so a copy
+        // has to build its own, the slots can be shared
+        SymbolMap(SymbolMap const & other)
+            : m_chunks{}, m_slots{other.m_slots}, m_shift{other.m_shift}, m_size{0}
+        {
+            for (auto const & [key, value] : other) {
+                emplace_back(key, value);
+            }
+        }
+
+        SymbolMap(SymbolMap && other) noexcept
+            : m_chunks{std::move(other.m_chunks)}, m_slots{std::move(other.m_slots)}
+            , m_shift{std::exchange(other.m_shift, 64)}
+            , m_size{std::exchange(other.m_size, 0)}
+        { }
+
+        SymbolMap & operator=(SymbolMap const & other) {
+            if (this != &other) {
+                auto copy = other;
+                *this = std::move(copy);
+            }
+
+            return *this;
+        }
+
+        SymbolMap & operator=(SymbolMap && other) noexcept {
+            if (this != &other) {
+                clear();
+                m_chunks = std::move(other.m_chunks);
+                m_slots = std::move(other.m_slots);
+                m_shift = std::exchange(other.m_shift, 64);
+                m_size = std::exchange(other.m_size, 0);
+            }
+
+            return *this;
+        }
+
+        SymbolMap(std::initializer_list<value_type> init) {
+            for (auto const & [key, value] : init) {
+                try_emplace(key, value);
+            }
+        }
+
+        ~SymbolMap() {
+            clear();
+        }
+
+    // Helpers
+    private:
+        struct Slot {
+            std::uint32_t id;
+            std::uint32_t index;
+        };
+
+        // Raw room for chunk_size entries, they're
+        // constructed and destroyed one at a time
+        static constexpr std::uint32_t chunk_bits = 5;
+        static constexpr std::uint32_t chunk_size = 1u << chunk_bits;
+        struct Chunk {
+            alignas(value_type) std::byte bytes[sizeof(value_type) * chunk_size];
+        };
+
+        static constexpr std::uint32_t no_entry = std::numeric_limits<std::uint32_t>::max();
+
+        value_type & entry(std::uint32_t index) noexcept {
+            auto * first = reinterpret_cast<value_type *>(m_chunks[index >> chunk_bits]->bytes);
+            return *std::launder(first + (index & (chunk_size - 1)));
+        }
+
+        value_type const & entry(std::uint32_t index) const noexcept {
+            auto * first = reinterpret_cast<value_type const *>(m_chunks[index >> chunk_bits]->bytes);
+            return *std::launder(first + (index & (chunk_size - 1)));
+        }
+
+        template <typename... Args>
+        void emplace_back(Symbol const & key, Args &&... args) {
+            if (m_size == m_chunks.size() * chunk_size) {
+                m_chunks.push_back(std::make_unique<Chunk>());
+            }
+
+            auto * first = reinterpret_cast<value_type *>(m_chunks[m_size >> chunk_bits]->bytes);
+            ::new (static_cast<void *>(first + (m_size & (chunk_size - 1)))) value_type(
+                std::piecewise_construct,
+                std::forward_as_tuple(key),
+                std::forward_as_tuple(std::forward<Args>(args)...)
+            );
+
+            ++m_size;
+        }
+
+        void clear() noexcept {
+            for (auto i = std::uint32_t{0}; i < m_size; ++i) {
+                std::destroy_at(&entry(i));
+            }
+
+            m_chunks.clear();
+            m_slots.clear();
+            m_shift = 64;
+            m_size = 0;
+        }
+
+        // Fibonacci hashing, ids are handed out one after the other
+        // and the multiply spreads them over the whole table
+        std::size_t home(std::uint32_t id) const noexcept {
+            return static_cast<std::size_t>(
+                (std::uint64_t{id} * 0x9e37'79b9'7f4a'7c15ull) >> m_shift
+            );
+        }
+
+        std::uint32_t lookup(std::uint32_t id) const noexcept {
+            if (m_slots.empty()) {
+                return no_entry;
+            }
+
+            auto const mask = m_slots.size() - 1;
+            for (auto pos = home(id); ; pos = (pos + 1) & mask) {
+                auto const & slot = m_slots[pos];
+                if (slot.index == no_entry || slot.id == id) {
+                    return slot.index;
+                }
+            }
+        }
+
+        void place(Slot slot) noexcept {
+            auto const mask = m_slots.size() - 1;
+            auto pos = home(slot.id);
+            while (m_slots[pos].index != no_entry) {
+                pos = (pos + 1) & mask;
+            }
+
+            m_slots[pos] = slot;
+        }
+
+        void rehash(std::size_t capacity) {
+            m_slots.assign(capacity, Slot{0, no_entry});
+            m_shift = 64 - std::countr_zero(capacity);
+            for (auto i = std::uint32_t{0}; i < m_size; ++i) {
+                place(Slot{entry(i).first.id(), i});
+            }
+        }
+
+    // Data
+    private:
+        std::vector<std::unique_ptr<Chunk>> m_chunks;
+        std::vector<Slot> m_slots;
+        int m_shift = 64;
+        std::uint32_t m_size = 0;
+    };
+}
+
+#endif
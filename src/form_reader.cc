@@ -0,0 +1,99 @@
+#include "form_reader.hh"
+#include <algorithm>
+#include <cstring>
+#include <istream>
+
+namespace esquema {
+    Cell const * FormReader::next() {
+        while (!m_forms || m_next == m_forms->size()) {
+            if (!parse_window()) {
+                return nullptr;
+            }
+        }
+
+        return &(*m_forms)[m_next++];
+    }
+
+    FormReader::FormReader(std::string_view src, std::size_t window)
+        : m_in{nullptr}, m_file{nullptr}, m_buffer{}
+        , m_done{src.data()}, m_end{src.data() + src.size()}
+        , m_row{1}, m_col{1}, m_eof{true}
+        , m_window{std::max<std::size_t>(window, 1)}
+        , m_scanner{src.data()}, m_parser{}
+        , m_forms{nullptr}, m_next{0}
+    { }
+
+    FormReader::FormReader(MappedFile & file, std::size_t window)
+        : FormReader{file.text(), window}
+    {
+        m_file = &file;
+    }
+
+    FormReader::FormReader(std::istream & in, std::size_t window)
+        : m_in{&in}, m_file{nullptr}, m_buffer{}
+        , m_done{nullptr}, m_end{nullptr}
+        , m_row{1}, m_col{1}, m_eof{false}
+        , m_window{std::max<std::size_t>(window, 1)}
+        , m_scanner{nullptr}, m_parser{}
+        , m_forms{nullptr}, m_next{0}
+    { }
+
+    // Parses from m_done up to the first cut past a window's worth of
+    // text. At the end of the source whatever is left is the window,
+    // if there's something unbalanced in it the Parser will say so.
+    bool FormReader::parse_window() {
+        while (true) {
+            auto const available = static_cast<std::size_t>(m_end - m_done);
+            m_scanner.advance(m_done + std::min(m_window, available));
+            auto at = m_scanner.next_boundary(m_end);
+            if (!at && !m_eof) {
+                m_eof = !refill();
+                continue;
+            }
+
+            if (!at) {
+                if (m_done == m_end) {
+                    return false;
+                }
+
+                at = m_end;
+            }
+
+            m_forms = &m_parser.parse_all(std::string_view(m_done, at), m_row, m_col);
+            m_next = 0;
+            m_done = at;
+            m_row = m_scanner.row();
+            m_col = m_scanner.col();
+            if (m_file) {
+                m_file->release(m_done);
+            }
+
+            return true;
+        }
+    }
+
+    // Moves what hasn't been parsed to the front of the buffer and
+    // reads another window's worth after it. The buffer only grows
+    // when a form is bigger than what's already there. The forms
+    // don't point into the source so the old text can go.
+    bool FormReader::refill() {
+        auto const keep = static_cast<std::size_t>(m_end - m_done);
+        auto const size = std::max(m_buffer.size(), keep + m_window);
+        if (size != m_buffer.size()) {
+            std::vector<char> bigger(size);
+            std::copy(m_done, m_end, bigger.data());
+            m_scanner.rebase(m_done, bigger.data());
+            m_buffer.swap(bigger);
+        }
+
+        else {
+            std::memmove(m_buffer.data(), m_done, keep);
+            m_scanner.rebase(m_done, m_buffer.data());
+        }
+
+        m_done = m_buffer.data();
+        m_in->read(m_buffer.data() + keep, static_cast<std::streamsize>(size - keep));
+        m_end = m_done + keep + m_in->gcount();
+        return m_in->gcount() > 0;
+    }
+}
@@ -0,0 +1,67 @@
+#ifndef ESQUEMA_FORM_READER_HH_INCLUDED
+#define ESQUEMA_FORM_READER_HH_INCLUDED
+
+#include "ast.hh"
+#include "form_scanner.hh"
+#include "mapped_file.hh"
+#include "parser.hh"
+#include <cstddef>
+#include <iosfwd>
+#include <string_view>
+#include <vector>
+
+namespace esquema {
+    // Hands out the top level forms of a source one at a time. The
+    // source is taken a window at a time, cut where a FormScanner says
+    // no form is open, and each window is parsed in one go. Only the
+    // current window's forms are ever in memory, so how much memory
+    // it takes depends on the biggest form and not on the source.
+    //
+    // The source can be text that's already in memory, a MappedFile,
+    // whose pages are let go once they've been parsed, or a stream.
+    // Streams are read a chunk at a time into a buffer that only
+    // grows when a single form doesn't fit in it, that's the one to
+    // use for pipes.
+    class FormReader {
+    // Interface
+    public:
+        // The next form or nullptr at the end of the source. The
+        // form is good until the next call. If a window fails to
+        // parse the error is thrown and reading can't go on.
+        Cell const * next();
+
+    // Constructors
+    public:
+        explicit FormReader(std::string_view src, std::size_t window = default_window);
+        explicit FormReader(MappedFile & file, std::size_t window = default_window);
+        explicit FormReader(std::istream & in, std::size_t window = default_window);
+
+    // Helpers
+    private:
+        bool parse_window();
+        bool refill();
+
+    // Data
+    private:
+        static constexpr std::size_t default_window = 256 * 1024;
+
+        std::istream * m_in;
+        MappedFile * m_file;
+        std::vector<char> m_buffer;
+
+        // The text from m_done up to m_end hasn't been parsed
+        // yet, m_row and m_col are where m_done is in the source
+        char const * m_done;
+        char const * m_end;
+        int m_row, m_col;
+        bool m_eof;
+        std::size_t m_window;
+
+        FormScanner m_scanner;
+        Parser m_parser;
+        List const * m_forms;
+        std::size_t m_next;
+    };
+}
+
+#endif
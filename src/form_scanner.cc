@@ -0,0 +1,100 @@
+#include "form_scanner.hh"
+#include <cstring>
+
+namespace esquema {
+    char const * FormScanner::next_boundary(char const * last) noexcept {
+        return scan<true>(last);
+    }
+
+    void FormScanner::advance(char const * pos) noexcept {
+        if (pos > m_pos) {
+            scan<false>(pos);
+        }
+    }
+
+    char const * FormScanner::position() const noexcept {
+        return m_pos;
+    }
+
+    int FormScanner::row() const noexcept {
+        return m_row;
+    }
+
+    int FormScanner::col() const noexcept {
+        return m_line_col + static_cast<int>(m_pos - m_line);
+    }
+
+    // The start of the current line may be in the part that's gone,
+    // in that case the column it had is folded into m_line_col
+    void FormScanner::rebase(char const * from, char const * to) noexcept {
+        if (m_line < from) {
+            m_line_col += static_cast<int>(from - m_line);
+            m_line = to;
+        }
+
+        else {
+            m_line = to + (m_line - from);
+        }
+
+        m_pos = to + (m_pos - from);
+    }
+
+    FormScanner::FormScanner(char const * first) noexcept
+        : m_pos{first}, m_line{first}
+        , m_row{1}, m_line_col{1}, m_depth{0}, m_comment{false}
+    { }
+
+    // Comments are the only place a paren doesn't count, there are
+    // no strings or characters in the language yet
+    template <bool Stop>
+    char const * FormScanner::scan(char const * last) noexcept {
+        auto p = m_pos;
+        while (p != last) {
+            if (m_comment) {
+                auto eol = static_cast<char const *>(
+                    std::memchr(p, '\n', static_cast<std::size_t>(last - p))
+                );
+
+                if (!eol) {
+                    p = last;
+                    break;
+                }
+
+                p = eol;
+                m_comment = false;
+            }
+
+            switch (*p++) {
+                case '(':
+                    ++m_depth;
+                    break;
+                case ')':
+                    // A stray ')' doesn't open anything up again
+                    if (m_depth > 0 && --m_depth == 0 && Stop) {
+                        m_pos = p;
+                        return p;
+                    }
+
+                    break;
+                case ';':
+                    m_comment = true;
+                    break;
+                case '\n':
+                    ++m_row;
+                    m_line = p;
+                    m_line_col = 1;
+                    if (m_depth == 0 && Stop) {
+                        m_pos = p;
+                        return p;
+                    }
+
+                    break;
+                default:
+                    break;
+            }
+        }
+
+        m_pos = p;
+        return nullptr;
+    }
+}
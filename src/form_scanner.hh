@@ -0,0 +1,56 @@
+#ifndef ESQUEMA_FORM_SCANNER_HH_INCLUDED
+#define ESQUEMA_FORM_SCANNER_HH_INCLUDED
+
+#include <string_view>
+
+namespace esquema {
+    // Finds the places in a source where no form is open, that is
+    // right after a newline or a ')' at the top level. Text can be
+    // cut at those places and each piece handed to its own Parser.
+    // Only parens, comments and newlines are looked at so it runs a
+    // lot faster than the Lexer does. Anything unbalanced is left for
+    // the Parser to complain about. The scanner remembers where it
+    // got to, so text that arrives in pieces can be scanned as it
+    // comes, and the row and column are kept for whoever parses the
+    // text that comes next.
+    class FormScanner {
+    // Interface
+    public:
+        // Scans up to last and returns the first place on the
+        // way where a cut can be made or nullptr if there isn't one
+        char const * next_boundary(char const * last) noexcept;
+
+        // Scans up to pos without stopping, it does nothing if the
+        // scanner is already past pos
+        void advance(char const * pos) noexcept;
+
+        // Where the scan got to and its row and column
+        char const * position() const noexcept;
+        int row() const noexcept;
+        int col() const noexcept;
+
+        // For buffers that get compacted, the text at from has
+        // moved to to and everything in front of it is gone
+        void rebase(char const * from, char const * to) noexcept;
+
+    // Constructors
+    public:
+        explicit FormScanner(char const * first) noexcept;
+
+    // Helpers
+    private:
+        template <bool Stop>
+        char const * scan(char const * last) noexcept;
+
+    // Data
+    private:
+        char const * m_pos;
+        char const * m_line;
+        int m_row;
+        int m_line_col;
+        int m_depth;
+        bool m_comment;
+    };
+}
+
+#endif
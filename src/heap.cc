@@ -0,0 +1,237 @@
+#include "heap.hh"
+#include <algorithm>
+#include <atomic>
+
+namespace esquema {
+    Object::Kind Object::kind() const noexcept {
+        return m_kind;
+    }
+
+    bool Object::managed() const noexcept {
+        return m_managed;
+    }
+
+    void Object::trace(Tracer &) const { }
+
+    std::size_t Object::bytes() const noexcept {
+        return sizeof(Object);
+    }
+
+    void Object::pin() const noexcept {
+        ++m_pins;
+    }
+
+    void Object::unpin() const noexcept {
+        if (--m_pins == 0 && m_orphan) {
+            delete this;
+        }
+    }
+
+    Object::Object(Kind kind) noexcept
+        : m_kind{kind}, m_managed{false}, m_orphan{false}, m_pins{0}, m_mark{0}
+    { }
+
+    Object::Object(Object const & other) noexcept
+        : Object{other.m_kind}
+    { }
+
+    // Whatever we were, managed and pinned, we still are
+    Object & Object::operator=(Object const &) noexcept {
+        return *this;
+    }
+
+    void pin(Value value) noexcept {
+        if (auto obj = value.heap_object()) {
+            obj->pin();
+        }
+    }
+
+    void unpin(Value value) noexcept {
+        if (auto obj = value.heap_object()) {
+            obj->unpin();
+        }
+    }
+
+    Value PairObject::car() const noexcept {
+        return m_car;
+    }
+
+    Value PairObject::cdr() const noexcept {
+        return m_cdr;
+    }
+
+    std::size_t PairObject::length() const noexcept {
+        return m_length;
+    }
+
+    void PairObject::trace(Tracer & tracer) const {
+        tracer.mark(m_car);
+        tracer.mark(m_cdr);
+    }
+
+    std::size_t PairObject::bytes() const noexcept {
+        return sizeof(PairObject);
+    }
+
+    PairObject::PairObject(Value car, Value cdr) noexcept
+        : Object{Kind::Pair}, m_car{car}, m_cdr{cdr}
+        , m_length{cdr.is_pair() ? cdr.pair()->length() + 1 : 1}
+    { }
+
+    Proc ProcObject::proc() const noexcept {
+        return m_proc;
+    }
+
+    ProcObject::ProcObject(Proc proc) noexcept
+        : Object{Kind::Proc}, m_proc{proc}
+    { }
+
+    BigInt const & BigObject::value() const noexcept {
+        return m_value;
+    }
+
+    // The first couple of limbs are in the BigInt itself
+    std::size_t BigObject::bytes() const noexcept {
+        auto limbs = m_value.limbs().size();
+        return sizeof(BigObject)
+            + (limbs > BigInt::inline_limbs ? limbs * sizeof(std::uint64_t) : 0);
+    }
+
+    BigObject::BigObject(BigInt value) noexcept
+        : Object{Kind::BigInt}, m_value{std::move(value)}
+    { }
+
+    void Tracer::mark(Value value) {
+        if (auto obj = value.heap_object()) {
+            mark(obj);
+        }
+    }
+
+    void Tracer::mark(Object const * obj) {
+        if (obj && !marked(*obj)) {
+            obj->m_mark = m_epoch;
+            m_pending.push_back(obj);
+        }
+    }
+
+    Tracer::Tracer(std::uint64_t epoch) noexcept
+        : m_pending{}, m_epoch{epoch}
+    { }
+
+    bool Tracer::marked(Object const & obj) const noexcept {
+        return obj.m_mark == m_epoch;
+    }
+
+    void Tracer::drain() {
+        while (!m_pending.empty()) {
+            auto obj = m_pending.back();
+            m_pending.pop_back();
+            obj->trace(*this);
+        }
+    }
+
+    bool Heap::wants_collection() const noexcept {
+        return m_made - m_made_at_last >= m_threshold;
+    }
+
+    void Heap::clear() noexcept {
+        orphan_pinned();
+        m_objects.clear();
+        m_made_at_last = m_made;
+    }
+
+    std::size_t Heap::size() const noexcept {
+        return m_objects.size();
+    }
+
+    Heap::Stats Heap::stats() const noexcept {
+        auto bytes = std::size_t{0};
+        for (auto const & obj : m_objects) {
+            bytes += obj->bytes();
+        }
+
+        return Stats{
+            m_objects.size(), bytes, m_made, m_freed, m_collections, m_threshold
+        };
+    }
+
+    std::uint64_t Heap::id() const noexcept {
+        return m_id;
+    }
+
+    Heap::Heap(std::size_t threshold)
+        : m_objects{}, m_initial_threshold{threshold}, m_threshold{threshold}
+        , m_made{0}, m_made_at_last{0}, m_freed{0}, m_collections{0}, m_id{next_id()}
+    { }
+
+    Heap::Heap(Heap && other) noexcept
+        : m_objects{std::move(other.m_objects)}
+        , m_initial_threshold{other.m_initial_threshold}, m_threshold{other.m_threshold}
+        , m_made{other.m_made}, m_made_at_last{other.m_made_at_last}
+        , m_freed{other.m_freed}, m_collections{other.m_collections}
+        , m_id{std::exchange(other.m_id, next_id())}
+    { }
+
+    // Whatever's pinned here outlives this Heap's objects, same as in
+    // the destructor
+    Heap & Heap::operator=(Heap && other) noexcept {
+        if (this == &other) {
+            return *this;
+        }
+
+        orphan_pinned();
+        m_objects = std::move(other.m_objects);
+        m_initial_threshold = other.m_initial_threshold;
+        m_threshold = other.m_threshold;
+        m_made = other.m_made;
+        m_made_at_last = other.m_made_at_last;
+        m_freed = other.m_freed;
+        m_collections = other.m_collections;
+        m_id = std::exchange(other.m_id, next_id());
+        return *this;
+    }
+
+    Heap::~Heap() {
+        orphan_pinned();
+    }
+
+    // Epochs are handed out to every Heap from the one counter, an
+    // Object marked by one Heap never looks marked to another
+    std::uint64_t Heap::next_epoch() noexcept {
+        static std::atomic<std::uint64_t> epochs{1};
+        return epochs.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    std::uint64_t Heap::next_id() noexcept {
+        static std::atomic<std::uint64_t> ids{1};
+        return ids.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void Heap::sweep(Tracer & tracer) {
+        for (auto const & obj : m_objects) {
+            if (obj->m_pins) {
+                tracer.mark(obj.get());
+            }
+        }
+
+        tracer.drain();
+        auto live = std::partition(m_objects.begin(), m_objects.end(), [&] (auto const & obj) {
+            return tracer.marked(*obj);
+        });
+
+        m_freed += static_cast<std::size_t>(m_objects.end() - live);
+        m_objects.erase(live, m_objects.end());
+        m_threshold = std::max(m_initial_threshold, 2 * m_objects.size());
+        m_made_at_last = m_made;
+        ++m_collections;
+    }
+
+    void Heap::orphan_pinned() noexcept {
+        for (auto & obj : m_objects) {
+            if (obj->m_pins) {
+                obj->m_orphan = true;
+                obj.release();
+            }
+        }
+    }
+}
@@ -0,0 +1,254 @@
+#ifndef ESQUEMA_HEAP_HH_INCLUDED
+#define ESQUEMA_HEAP_HH_INCLUDED
+
+#include "bigint.hh"
+#include "value.hh"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace esquema {
+    class Tracer;
+
+    // Anything a Value can't hold directly is an Object. The kind
+    // lets us get back to the concrete type without RTTI.
+    //
+    // Objects made through a Heap are managed, the Heap frees them
+    // once nothing it can see refers to them any longer. Something
+    // outside the Heap that holds on to one, a Lambda handed back to
+    // the caller say, pins it and the collector leaves it alone until
+    // it's unpinned. Objects that aren't managed, like the global
+    // Environment, belong to whoever made them.
+    class Object {
+    // Friends
+    public:
+        friend class Heap;
+        friend class Tracer;
+
+    public:
+        enum class Kind : std::uint8_t {
+            Pair, Proc, Closure, Environment, BigInt
+        };
+
+    // Interface
+    public:
+        Kind kind() const noexcept;
+        bool managed() const noexcept;
+
+        // Marks everything this refers to, the collector calls it
+        virtual void trace(Tracer & tracer) const;
+
+        // Roughly how much memory this takes up, for Heap::stats
+        virtual std::size_t bytes() const noexcept;
+
+        // Pins nest, the last unpin of an Object whose Heap has
+        // gone away deletes it
+        void pin() const noexcept;
+        void unpin() const noexcept;
+
+    // Constructors
+    public:
+        virtual ~Object() = default;
+
+    protected:
+        explicit Object(Kind kind) noexcept;
+
+        // A copy is a new Object, it isn't on anybody's Heap
+        // and nothing has pinned it yet
+        Object(Object const & other) noexcept;
+        Object & operator=(Object const & other) noexcept;
+
+    // Data
+    private:
+        Kind m_kind;
+        bool m_managed;
+        bool m_orphan;
+        mutable std::uint32_t m_pins;
+
+        // The collection that last marked us, see Tracer
+        mutable std::uint64_t m_mark;
+    };
+
+    // Pin and unpin whatever value points to, if anything
+    void pin(Value value) noexcept;
+    void unpin(Value value) noexcept;
+
+    // One link of a list, the empty list is the null Object. Pairs
+    // never change once they're made, so consing onto a list shares
+    // it as the tail instead of copying it and handing a list around
+    // is handing a pointer around. The cdr is always a list, so every
+    // pair knows how long the list starting at it is.
+    class PairObject : public Object {
+    // Interface
+    public:
+        Value car() const noexcept;
+        Value cdr() const noexcept;
+        std::size_t length() const noexcept;
+        void trace(Tracer & tracer) const override;
+        std::size_t bytes() const noexcept override;
+
+    // Constructors
+    public:
+        // cdr has to be a list, see Value::is_list
+        PairObject(Value car, Value cdr) noexcept;
+
+    // Data
+    private:
+        Value m_car;
+        Value m_cdr;
+        std::size_t m_length;
+    };
+
+    // A proc with the old calling convention. They don't get
+    // a tag of their own in a Value, there are too few to go
+    // around and hardly anybody writes these anymore.
+    class ProcObject : public Object {
+    // Interface
+    public:
+        Proc proc() const noexcept;
+
+    // Constructors
+    public:
+        explicit ProcObject(Proc proc) noexcept;
+
+    // Data
+    private:
+        Proc m_proc;
+    };
+
+    // An exact integer too big to be a fixnum. Like pairs they never
+    // change once they're made, arithmetic makes new ones.
+    class BigObject : public Object {
+    // Interface
+    public:
+        BigInt const & value() const noexcept;
+        std::size_t bytes() const noexcept override;
+
+    // Constructors
+    public:
+        explicit BigObject(BigInt value) noexcept;
+
+    // Data
+    private:
+        BigInt m_value;
+    };
+
+    // The mark half of a collection. Whatever is marked gets traced
+    // in turn, with a list of what's still to do instead of recursion
+    // so a long chain of Environments can't blow the C++ stack.
+    // Every collection gets a new epoch, an Object whose mark is the
+    // current epoch has been seen, which saves clearing the marks.
+    class Tracer {
+    // Interface
+    public:
+        void mark(Value value);
+        void mark(Object const * obj);
+
+    // Constructors
+    public:
+        explicit Tracer(std::uint64_t epoch) noexcept;
+
+    // Helpers
+    private:
+        friend class Heap;
+        bool marked(Object const & obj) const noexcept;
+        void drain();
+
+    // Data
+    private:
+        std::vector<Object const *> m_pending;
+        std::uint64_t m_epoch;
+    };
+
+    // The Heap owns every Object that gets made through it. It's a
+    // plain mark and sweep collector and it's precise: it only ever
+    // collects when asked to, at a point where whoever asks can name
+    // every Value and Object they're holding on to, and it never
+    // looks at the C++ stack. The VM asks on the way into a lambda
+    // and at the start of a run, the tree walker does the same, and
+    // that's enough to keep a loop in bounded space since every loop
+    // is a call. Making objects never collects, so natives can make
+    // as many as they like without worrying about the ones before.
+    //
+    // A collection is due once enough objects have been made since
+    // the last one. After each collection the threshold goes to twice
+    // what survived, so a program that keeps a lot around doesn't
+    // spend all its time marking it.
+    class Heap {
+    public:
+        struct Stats {
+            std::size_t objects;        // alive right now
+            std::size_t bytes;          // roughly what they take up
+            std::size_t made;           // since the Heap was made
+            std::size_t freed;          // by every collection so far
+            std::size_t collections;
+            std::size_t threshold;      // objects made before the next one
+        };
+
+        static constexpr std::size_t default_threshold = 4096;
+
+    // Interface
+    public:
+        template <typename T, typename... Args>
+        T * make(Args &&... args) {
+            auto obj = std::make_unique<T>(std::forward<Args>(args)...);
+            auto ptr = obj.get();
+            ptr->m_managed = true;
+            m_objects.push_back(std::move(obj));
+            ++m_made;
+            return ptr;
+        }
+
+        bool wants_collection() const noexcept;
+
+        // roots is called with a Tracer and has to mark everything
+        // the caller holds, pinned Objects are taken care of here
+        template <typename Roots>
+        void collect(Roots && roots) {
+            Tracer tracer{next_epoch()};
+            roots(tracer);
+            sweep(tracer);
+        }
+
+        // Frees everything that isn't pinned, no marking at all
+        void clear() noexcept;
+        std::size_t size() const noexcept;
+        Stats stats() const noexcept;
+
+        // Every Heap gets its own id, whatever is left behind by a
+        // move gets a new one. Code uses it to tell whose copies of
+        // its constants it's holding on to.
+        std::uint64_t id() const noexcept;
+
+    // Constructors
+    public:
+        explicit Heap(std::size_t threshold = default_threshold);
+        Heap(Heap && other) noexcept;
+        Heap & operator=(Heap && other) noexcept;
+        ~Heap();
+
+    // Helpers
+    private:
+        static std::uint64_t next_epoch() noexcept;
+        static std::uint64_t next_id() noexcept;
+        void sweep(Tracer & tracer);
+
+        // Pinned Objects outlive us, the last unpin deletes them
+        void orphan_pinned() noexcept;
+
+    // Data
+    private:
+        std::vector<std::unique_ptr<Object>> m_objects;
+        std::size_t m_initial_threshold;
+        std::size_t m_threshold;
+        std::size_t m_made;
+        std::size_t m_made_at_last;
+        std::size_t m_freed;
+        std::size_t m_collections;
+        std::uint64_t m_id;
+    };
+}
+
+#endif
@@ -0,0 +1,61 @@
+#include "intern.hh"
+#include "builtins.hh"
+#include <mutex>
+
+namespace esquema {
+    SymbolTable & SymbolTable::global() {
+        static SymbolTable table{};
+        return table;
+    }
+
+    std::uint32_t SymbolTable::intern(std::string_view name) {
+        auto key = traits_cast<std::char_traits<char>, ci_char_traits>(name);
+        {
+            std::shared_lock lock{m_mutex};
+            if (auto it = m_ids.find(key); it != m_ids.end()) {
+                return it->second;
+            }
+        }
+
+        // Somebody may have beaten us to it between the locks
+        // so emplace only inserts if it is still missing
+        std::unique_lock lock{m_mutex};
+        if (auto it = m_ids.find(key); it != m_ids.end()) {
+            return it->second;
+        }
+
+        auto id = static_cast<std::uint32_t>(m_names.size());
+        auto const & stored = m_names.emplace_back(key);
+        m_ids.emplace(CIStringView{stored}, id);
+        return id;
+    }
+
+    std::optional<std::uint32_t> SymbolTable::find(CIStringView name) const {
+        std::shared_lock lock{m_mutex};
+        if (auto it = m_ids.find(name); it != m_ids.end()) {
+            return it->second;
+        }
+
+        return {};
+    }
+
+    CIString const & SymbolTable::name(std::uint32_t id) const {
+        std::shared_lock lock{m_mutex};
+        return m_names[id];
+    }
+
+    // The keywords go in first so that their ids line up with
+    // Symbol::Keyword, the builtins follow in table order
+    SymbolTable::SymbolTable()
+        : m_names{}, m_ids{}, m_mutex{}
+    {
+        intern("define");
+        intern("if");
+        intern("begin");
+        intern("lambda");
+        intern("#<folded>");
+        for (auto const & builtin : builtins) {
+            intern(builtin.name);
+        }
+    }
+}
@@ -0,0 +1,49 @@
+#ifndef ESQUEMA_INTERN_HH_INCLUDED
+#define ESQUEMA_INTERN_HH_INCLUDED
+
+#include "ci_string.hh"
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <shared_mutex>
+#include <string_view>
+#include <unordered_map>
+
+namespace esquema {
+    // The SymbolTable hands out a small integer for every distinct
+    // name it is shown. Names are compared without regard to case
+    // so "Foo" and "FOO" get the same id, and the spelling that is
+    // kept is the first one the table saw. The case folding and the
+    // hashing happen exactly once per name, after that a Symbol is
+    // just an id and comparing or hashing it is an integer operation.
+    // There's a single global table shared by every interpreter and
+    // it is safe to intern from more than one thread.
+    class SymbolTable {
+    // Interface
+    public:
+        static SymbolTable & global();
+
+        std::uint32_t intern(std::string_view name);
+
+        // Doesn't add the name if it is missing, handy for lookups
+        // since a name that was never interned can't be bound
+        std::optional<std::uint32_t> find(CIStringView name) const;
+        CIString const & name(std::uint32_t id) const;
+
+    // Constructors
+    public:
+        SymbolTable();
+        SymbolTable(SymbolTable const &) = delete;
+        SymbolTable & operator=(SymbolTable const &) = delete;
+
+    // Data
+    private:
+        // deque so that the strings never move and the views
+        // used as keys stay valid
+        std::deque<CIString> m_names;
+        std::unordered_map<CIStringView, std::uint32_t> m_ids;
+        mutable std::shared_mutex m_mutex;
+    };
+}
+
+#endif
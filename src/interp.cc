@@ -1,128 +1,358 @@
 #include "interp.hh"
+#include "closure.hh"
+#include "native_proc.hh"
+#include <memory>
+#include <span>
 #include <sstream>
 #include <stdexcept>
 
-#include <iostream>
-
-namespace {
-    using namespace esquema::literals::ci_string_view_literals;
-}
-
 namespace esquema {
     Cell Interpreter::eval(std::string_view src) {
-        return eval(m_parser.parse(src));
+        return eval_form(m_parser.parse(src));
     }
 
-    Cell Interpreter::eval(Cell const & cell) {
-        // no need to evaluate just return them
-        if (cell.is_nil() || cell.is_number() || cell.is_bool()) {
-            return cell;
-        }
+    // The whole source is parsed up front in one pass. The VM gets
+    // it as one piece of Code, the tree walker goes form by form.
+    Cell Interpreter::eval_all(std::string_view src) {
+        return eval_all(m_parser.parse_all(src));
+    }
 
-        // the other atom does need to be resolved
-        else if (cell.is_symbol()) {
-            auto const & name = std::get<Symbol>(cell).value();
-            auto it = m_env.find(name);
-            if (it != m_env.end()) {
-                return it->second;
+    // For forms that came from somewhere else, a ParallelParser say.
+    // Everything goes through the Optimizer first, when it has
+    // nothing to say the forms are used as they are.
+    Cell Interpreter::eval_all(List const & forms) {
+        auto optimized = m_optimizer.optimize_all(forms, m_env);
+        auto const & program = optimized ? *optimized : forms;
+        if (m_engine == Engine::TreeWalker) {
+            reset();
+            auto result = Value{};
+            for (auto const & form : program) {
+                result = eval(form, m_env);
             }
 
-            else {
-                std::ostringstream msg{};
-                msg << "Dereferenced unbound variable '"
-                    << name << "'";
-
-                throw std::runtime_error{msg.str()};
-            }
+            return result.to_cell();
         }
 
-        else if (cell.is_list()) {
-            return eval(std::get<List>(cell));
-        }
+        return run(m_compiler.compile_all(program));
+    }
 
-        else {
-            return Nil{};
+    Cell Interpreter::eval_form(Cell const & form) {
+        auto optimized = m_optimizer.optimize(form, m_env);
+        auto const & cell = optimized ? *optimized : form;
+        if (m_engine == Engine::TreeWalker) {
+            reset();
+            return eval(cell, m_env).to_cell();
         }
+
+        return run(m_compiler.compile(cell));
     }
 
-    Cell Interpreter::eval(List const & list) {
-        if (list.empty()) {
-            return list;
-        }
+    Interpreter::Engine Interpreter::engine() const noexcept {
+        return m_engine;
+    }
 
-        // First try to handle the special forms
-        auto const & head = list.front();
-        if (head.is_symbol()) {
-            auto const & name = std::get<Symbol>(head).value();
-            if (name == "define"_cisv) {
-                if (list.size() != 3) {
-                    throw std::runtime_error{"define requires two arguments"};
-                }
+    Code Interpreter::compile(std::string_view src) {
+        auto const & form = m_parser.parse(src);
+        auto optimized = m_optimizer.optimize(form, m_env);
+        return m_compiler.compile(optimized ? *optimized : form);
+    }
+
+    Cell Interpreter::run(Code const & code) {
+        return m_vm.run(code, m_env);
+    }
+
+    // Nothing is running so the global environment is all there is
+    void Interpreter::collect() {
+        m_args.clear();
+        m_live.clear();
+        m_literals.clear();
+        collect(m_env);
+    }
 
-                auto it = ++list.begin();
-                auto var = *it++;
-                if (!var.is_symbol()) {
-                    throw std::runtime_error{"define requires a symbol to bind to"};
+    Heap::Stats Interpreter::heap_stats() const noexcept {
+        return m_vm.heap().stats();
+    }
+
+    // The tree walker. Tail positions, the branches of an if, the
+    // last form of a begin and the body of a lambda that's called,
+    // don't recurse, the loop goes around again with the new cell
+    // and Environment. Only what isn't in tail position, like the
+    // condition of an if or the arguments of a call, recurses. That
+    // way a loop written as a tail call runs in constant stack.
+    //
+    // Whatever a call holds on to has to be where collect can see
+    // it, the proc and its arguments on m_args and the closure we're
+    // running and its parameters on m_live. Values the recursion hands
+    // back are used up before anything else gets evaluated.
+    //
+    // Nothing here copies a Cell, it's all references into the parse
+    // tree or a Function's body. within is the Function whose body the
+    // cell is in, a lambda in there already has a Function of its own.
+    Value Interpreter::eval(Cell const & expr, Environment & top, Function const * within) {
+        auto const * cell = &expr;
+        auto * env = &top;
+
+        // Whatever we put on m_live comes off again on the way out
+        struct Unwind {
+            std::vector<Object const *> & live;
+            std::size_t size;
+            ~Unwind() { live.resize(size); }
+        } unwind{m_live, m_live.size()};
+
+        while (true) {
+            // no need to evaluate just return them
+            if (cell->is_nil()) {
+                return Nil{};
+            }
+
+            // Bignums have to go on the heap
+            else if (cell->is_number()) {
+                return literal(*cell);
+            }
+
+            else if (cell->is_bool()) {
+                return std::get<Bool>(*cell);
+            }
+
+            // the other atom does need to be resolved
+            else if (cell->is_symbol()) {
+                auto const & sym = std::get<Symbol>(*cell);
+                auto it = env->find(sym);
+                if (it != env->end()) {
+                    return it->second;
                 }
 
-                m_env.insert(std::get<Symbol>(var), eval(*it));
+                std::ostringstream msg{};
+                msg << "Dereferenced unbound variable '"
+                    << sym << "'";
+
+                throw std::runtime_error{msg.str()};
+            }
+
+            else if (!cell->is_list()) {
                 return Nil{};
             }
 
-            else if (name == "if"_cisv) {
-                if (list.size() < 3) {
-                    throw std::runtime_error{"if requires either two or three arguments"};
+            auto const & list = std::get<List>(*cell);
+            if (list.empty()) {
+                return Value::empty_list();
+            }
+
+            // First try to handle the special forms
+            auto const & head = list.front();
+            if (head.is_symbol()) {
+                auto const id = std::get<Symbol>(head).id();
+                if (id == Symbol::Define) {
+                    if (list.size() != 3) {
+                        throw std::runtime_error{"define requires two arguments"};
+                    }
+
+                    auto const & var = list[1];
+                    if (!var.is_symbol()) {
+                        throw std::runtime_error{"define requires a symbol to bind to"};
+                    }
+
+                    env->insert(std::get<Symbol>(var), eval(list[2], *env, within));
+                    return Nil{};
                 }
-                auto it = ++list.begin();
-                auto cond = eval(*it++);
-                if (!cond.is_bool()) {
-                    throw std::runtime_error{"if condition must evaluate to boolean"};
+
+                else if (id == Symbol::If) {
+                    if (list.size() < 3) {
+                        throw std::runtime_error{"if requires either two or three arguments"};
+                    }
+
+                    auto cond = eval(list[1], *env, within);
+                    if (!cond.is_bool()) {
+                        throw std::runtime_error{"if condition must evaluate to boolean"};
+                    }
+
+                    if (cond.boolean()) {
+                        cell = &list[2];
+                    }
+
+                    else if (list.size() == 4) {
+                        cell = &list[3];
+                    }
+
+                    else {
+                        return Nil{};
+                    }
+
+                    continue;
                 }
 
-                auto true_path = *it++;
-                auto false_path = Cell{};
-                if (list.size() == 4) {
-                    false_path = *it++;
+                else if (id == Symbol::Begin) {
+                    if (list.size() == 1) {
+                        return Nil{};
+                    }
+
+                    for (auto it = ++list.begin(); it != list.end() - 1; ++it) {
+                        eval(*it, *env, within);
+                    }
+
+                    cell = &list.back();
+                    continue;
                 }
 
-                if (std::get<Bool>(cond).value()) {
-                    return eval(true_path);
+                else if (id == Symbol::Lambda) {
+                    if (auto msg = Function::malformed(list)) {
+                        throw std::runtime_error{msg};
+                    }
+
+                    auto function = within ? within->nested(list) : nullptr;
+                    if (!function) {
+                        function = std::make_shared<Function const>(list);
+                    }
+
+                    Closure const * closure = heap().make<Closure>(std::move(function), env);
+                    return closure;
                 }
 
-                else {
-                    return eval(false_path);
+                // The builtins are only ever in the global Environment
+                else if (id == Symbol::Folded && list.size() == 4) {
+                    auto const guard = static_cast<std::uint64_t>(std::get<Number>(list[3]).exact());
+                    if (!(guard & hidden_builtins())) {
+                        return Value::from_cell(list[1], heap());
+                    }
+
+                    cell = &list[2];
+                    continue;
                 }
             }
 
-            else if (name == "begin"_cisv) {
-                Cell result;
-                for (auto it = ++list.begin(); it != list.end(); ++it) {
-                    result = eval(*it);
-                }
+            // If we got here now we need to try and find
+            // the proc in environment
+            auto maybe_proc = eval(head, *env, within);
+            if (!maybe_proc.is_native() && !maybe_proc.is_closure() && !maybe_proc.is_proc()) {
+                throw std::runtime_error{"Not a procedure"};
+            }
+
+            // The proc and its arguments go on a stack that's kept
+            // around from call to call, calls made while evaluating
+            // them go on top and are gone again before the next one
+            auto const mark = m_args.size();
+            m_args.push_back(maybe_proc);
+            for (auto it = ++list.begin(); it != list.end(); ++it) {
+                auto arg = eval(*it, *env, within);
+                m_args.push_back(arg);
+            }
 
+            auto args = std::span<Value const>{m_args}.subspan(mark + 1);
+            if (!maybe_proc.is_closure()) {
+                auto result = maybe_proc.is_native()
+                    ? maybe_proc.native()(args, heap())
+                    : call_proc(static_cast<ProcObject const *>(maybe_proc.object())->proc(), args, env, heap());
+
+                m_args.resize(mark);
                 return result;
             }
+
+            // Everything but the last form of the body happens
+            // here, that one is where we go around again. The
+            // closure we came from isn't needed anymore.
+            auto const * closure = maybe_proc.closure();
+            auto const & function = closure->function();
+            function.check_arity(args.size());
+            if (heap().wants_collection()) {
+                collect(*env);
+            }
+
+            auto * next = heap().make<Environment>(closure->env());
+            for (auto i = std::size_t{0}; i < args.size(); ++i) {
+                next->insert(function.params()[i], args[i]);
+            }
+
+            m_args.resize(mark);
+            m_live.resize(unwind.size);
+            m_live.push_back(closure);
+            m_live.push_back(next);
+
+            auto const body = function.body();
+            for (auto const & form : body.first(body.size() - 1)) {
+                eval(form, *next, &function);
+            }
+
+            cell = &body.back();
+            env = next;
+            within = &function;
+        }
+    }
+
+    // Anything an earlier evaluation left behind, it may have
+    // thrown half way through its arguments. Between evaluations
+    // the only root is the global environment.
+    void Interpreter::reset() {
+        m_args.clear();
+        m_live.clear();
+        m_literals.clear();
+        if (heap().wants_collection()) {
+            collect(m_env);
         }
+    }
 
-        // If we got here now we need to try and find
-        // the proc in environment
-        auto maybe_proc = eval(list.front());
-        if (maybe_proc.is_proc()) {
-            List args{};
-            for (auto it = ++list.begin(); it != list.end(); ++ it) {
-                args.push_back(eval(*it));
+    void Interpreter::collect(Environment & env) {
+        heap().collect([&] (Tracer & tracer) {
+            for (auto value : m_args) {
+                tracer.mark(value);
             }
 
-            auto const & proc = std::get<Proc>(maybe_proc);
-            return proc(args, &m_env);
+            for (auto obj : m_live) {
+                tracer.mark(obj);
+            }
+
+            for (auto const & [cell, value] : m_literals) {
+                tracer.mark(value);
+            }
+
+            tracer.mark(&env);
+            tracer.mark(&m_env);
+        });
+    }
+
+    // Both engines share the VM's heap, the tree walker just
+    // allocates on it
+    Heap & Interpreter::heap() noexcept {
+        return m_vm.heap();
+    }
+
+    // Only a literal that needs the heap is worth keeping. The cell
+    // may have gone since and another taken its place, a lambda's
+    // body that's been collected say, so a hit has to be the same
+    // number.
+    Value Interpreter::literal(Cell const & cell) {
+        auto const & num = std::get<Number>(cell);
+        auto const * exact = num.fixnum();
+        if (!num.is_big() && (!exact || Value::fits_fixnum(*exact))) {
+            return num;
+        }
+
+        if (auto it = m_literals.find(&cell); it != m_literals.end()) {
+            auto const & big = it->second.bignum()->value();
+            if (exact ? big.fits_int64() && big.to_int64() == *exact : big == num.big()) {
+                return it->second;
+            }
+        }
+
+        auto value = Value::from_cell(cell, heap());
+        m_literals.insert_or_assign(&cell, value);
+        return value;
+    }
+
+    std::uint64_t Interpreter::hidden_builtins() noexcept {
+        if (m_hidden_id != m_env.id()) {
+            m_hidden_id = m_env.id();
+            m_hidden = Optimizer::hidden(m_env);
         }
 
-        throw std::runtime_error{"Not a procedure"};
+        return m_hidden;
     }
 
     // Make an interpreter with the default global environment
-    Interpreter::Interpreter()
-        : m_env{Environment::make_global()}
-        , m_parser{}
+    Interpreter::Interpreter(Engine engine)
+        : m_parser{}, m_optimizer{}, m_compiler{}, m_vm{}
+        , m_env{Environment::make_global()}
+        , m_args{}, m_live{}
+        , m_engine{engine}, m_hidden{0}, m_hidden_id{0}
+        , m_literals{}
     { }
 }
@@ -1,36 +1,99 @@
 #ifndef ESQUEMA_INTERP_HH_INCLUDED
 #define ESQUEMA_INTERP_HH_INCLUDED
 
+#include "compiler.hh"
 #include "environ.hh"
+#include "heap.hh"
+#include "optimizer.hh"
 #include "parser.hh"
+#include "vm.hh"
+#include <cstdint>
 #include <unordered_map>
+#include <vector>
 
 namespace esquema {
     // The interpreter holds a parser and an environment.
     // It has the parser produce an abstract syntax tree
     // from the string you give it.
+    // The tree goes through the Optimizer on the way, see there.
     // It knowns how to traverses the abstract syntax tree 
     // and how to evaluate each node, producing a result value
     // at the very end. In Scheme atoms evaluate to themselves and
     // that is how we bottom out of the recursive function.
+    // By default the tree is compiled to bytecode and run on the
+    // VM, the tree walker sticks around as the reference engine.
     class Interpreter {
+    public:
+        enum class Engine : std::uint8_t {
+            Bytecode, TreeWalker
+        };
+
     // Interface
     public:
         Cell eval(std::string_view src);
 
+        // Evaluates every top level form in src in order and returns
+        // the value of the last one, Nil if there are none. Forms
+        // before a failing one have already taken effect.
+        Cell eval_all(std::string_view src);
+        Cell eval_all(List const & forms);
+
+        // One form that's already been parsed, from a FormReader say
+        Cell eval_form(Cell const & form);
+        Engine engine() const noexcept;
+
+        // If you are going to evaluate the same expression over
+        // and over compile it once and run the Code instead
+        Code compile(std::string_view src);
+        Cell run(Code const & code);
+
+        // Collects right away instead of waiting for the next call
+        // that wants to, then the stats say what's really alive
+        void collect();
+        Heap::Stats heap_stats() const noexcept;
+
     // Constructor
     public:
-        Interpreter();
+        explicit Interpreter(Engine engine = Engine::Bytecode);
 
     // Helpers
     private:
-        Cell eval(Cell const & cell);
-        Cell eval(List const & list);
+        Value eval(Cell const & cell, Environment & env, Function const * within = nullptr);
+        void reset();
+        void collect(Environment & env);
+        Heap & heap() noexcept;
+
+        // A number literal as a Value, see m_literals
+        Value literal(Cell const & cell);
+
+        // Optimizer::hidden for m_env, worked out again when its id changes
+        std::uint64_t hidden_builtins() noexcept;
 
     // Data
     private:
-        Environment m_env;
         Parser m_parser;
+        Optimizer m_optimizer;
+        Compiler m_compiler;
+
+        // The VM owns the heap, it has to outlive the environment
+        // since that pins whatever it's bound to
+        VM m_vm;
+        Environment m_env;
+
+        // The tree walker's roots, the procs and arguments of the
+        // calls it's in the middle of and the closures and scopes
+        // it's running
+        std::vector<Value> m_args;
+        std::vector<Object const *> m_live;
+        Engine m_engine;
+
+        std::uint64_t m_hidden;
+        std::uint64_t m_hidden_id;
+
+        // Number literals too big to be fixnums, boxed on the heap
+        // the first time they're evaluated. They're roots until the
+        // next reset, the VM knows nothing about them.
+        std::unordered_map<Cell const *, Value> m_literals;
     };
 }
 
@@ -1,43 +1,177 @@
 #include "lexer.hh"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstring>
 #include <stdexcept>
 #include <sstream>
+#include <string_view>
+
+// The skipping loops look at a whole vector of characters at a time.
+// AVX2 is used when the compiler is allowed to (-mavx2 or -march=native),
+// SSE2 is always there on x86-64, everybody else gets the scalar loop.
+// Define ESQUEMA_NO_SIMD to force the scalar loop everywhere.
+#if !defined(ESQUEMA_NO_SIMD) && defined(__AVX2__)
+#include <immintrin.h>
+#define ESQUEMA_LEXER_SIMD 32
+#elif !defined(ESQUEMA_NO_SIMD) && defined(__SSE2__)
+#include <emmintrin.h>
+#define ESQUEMA_LEXER_SIMD 16
+#else
+#define ESQUEMA_LEXER_SIMD 0
+#endif
+
+namespace {
+    using namespace std::literals::string_view_literals;
+
+    // Every character gets a set of these flags. One table lookup
+    // replaces the chains of comparisons and the locale dependent
+    // <cctype> calls.
+    enum CharClass : std::uint8_t {
+        Space = 1 << 0,
+        Initial = 1 << 1,
+        Subsequent = 1 << 2,
+        Digit = 1 << 3,
+        NumStart = 1 << 4,
+        BoolChar = 1 << 5
+    };
 
-namespace esquema {
-    Token Lexer::next() {
-        auto cur = peek();
-        if (!cur) {
-            return Token{Token::Type::Eof};
+    // See https://conservatory.scheme.org/schemers/Documents/Standards/R5RS/HTML/r5rs-Z-H-5.html#%_sec_2.1
+    // for the definition of an identifier
+    constexpr auto char_classes = [] {
+        std::array<std::uint8_t, 256> table{};
+        auto set = [&table] (std::string_view chars, std::uint8_t cls) {
+            for (auto c : chars) {
+                table[static_cast<unsigned char>(c)] |= cls;
+            }
+        };
+
+        for (auto c = 'a'; c <= 'z'; ++c) {
+            table[static_cast<unsigned char>(c)] |= Initial | Subsequent;
+            table[static_cast<unsigned char>(c - 'a' + 'A')] |= Initial | Subsequent;
+        }
+
+        for (auto c = '0'; c <= '9'; ++c) {
+            table[static_cast<unsigned char>(c)] |= Subsequent | Digit | NumStart;
         }
 
-        if (std::isspace(*cur)) {
-            consume_ws();
-            if (is_eof()) {
-                return Token{Token::Type::Eof};
+        set(" \t\n\v\f\r"sv, Space);
+        set("!$%&*/:<=>?~_^"sv, Initial | Subsequent);
+        set(".+-"sv, Subsequent | NumStart);
+        set("tTfF"sv, BoolChar);
+        return table;
+    }();
+
+    constexpr bool has(char c, std::uint8_t cls) noexcept {
+        return (char_classes[static_cast<unsigned char>(c)] & cls) != 0;
+    }
+
+#if ESQUEMA_LEXER_SIMD == 32
+    using Vec = __m256i;
+    constexpr std::uint32_t all_ones = 0xffff'ffff;
+    inline Vec load(char const * p) noexcept { return _mm256_loadu_si256(reinterpret_cast<__m256i const *>(p)); }
+    inline Vec splat(char c) noexcept { return _mm256_set1_epi8(c); }
+    inline Vec eq(Vec a, Vec b) noexcept { return _mm256_cmpeq_epi8(a, b); }
+    inline Vec min_u8(Vec a, Vec b) noexcept { return _mm256_min_epu8(a, b); }
+    inline Vec sub(Vec a, Vec b) noexcept { return _mm256_sub_epi8(a, b); }
+    inline Vec or_(Vec a, Vec b) noexcept { return _mm256_or_si256(a, b); }
+    inline Vec and_not(Vec a, Vec b) noexcept { return _mm256_andnot_si256(a, b); }
+    inline std::uint32_t bits(Vec v) noexcept { return static_cast<std::uint32_t>(_mm256_movemask_epi8(v)); }
+#elif ESQUEMA_LEXER_SIMD == 16
+    using Vec = __m128i;
+    constexpr std::uint32_t all_ones = 0xffff;
+    inline Vec load(char const * p) noexcept { return _mm_loadu_si128(reinterpret_cast<__m128i const *>(p)); }
+    inline Vec splat(char c) noexcept { return _mm_set1_epi8(c); }
+    inline Vec eq(Vec a, Vec b) noexcept { return _mm_cmpeq_epi8(a, b); }
+    inline Vec min_u8(Vec a, Vec b) noexcept { return _mm_min_epu8(a, b); }
+    inline Vec sub(Vec a, Vec b) noexcept { return _mm_sub_epi8(a, b); }
+    inline Vec or_(Vec a, Vec b) noexcept { return _mm_or_si128(a, b); }
+    inline Vec and_not(Vec a, Vec b) noexcept { return _mm_andnot_si128(a, b); }
+    inline std::uint32_t bits(Vec v) noexcept { return static_cast<std::uint32_t>(_mm_movemask_epi8(v)); }
+#endif
+
+#if ESQUEMA_LEXER_SIMD
+    // Unsigned lo <= c <= hi for every lane, the subtraction wraps
+    // everything below lo around to the top
+    inline Vec in_range(Vec v, char lo, char hi) noexcept {
+        auto shifted = sub(v, splat(lo));
+        return eq(min_u8(shifted, splat(static_cast<char>(hi - lo))), shifted);
+    }
+
+    // ' ' and \t through \r, same as the Space class
+    inline std::uint32_t space_bits(Vec v) noexcept {
+        return bits(or_(eq(v, splat(' ')), in_range(v, '\t', '\r')));
+    }
+
+    // The Subsequent class as ranges of ASCII, it has to be kept
+    // in step with the table above
+    inline std::uint32_t subsequent_bits(Vec v) noexcept {
+        auto punc = and_not(eq(v, splat(',')), in_range(v, '*', ':'));
+        auto mask = or_(punc, in_range(v, '<', '?'));
+        mask = or_(mask, in_range(v, 'A', 'Z'));
+        mask = or_(mask, in_range(v, '^', '_'));
+        mask = or_(mask, in_range(v, 'a', 'z'));
+        mask = or_(mask, in_range(v, '$', '&'));
+        mask = or_(mask, eq(v, splat('!')));
+        mask = or_(mask, eq(v, splat('~')));
+        return bits(mask);
+    }
+#endif
+
+    // Finds the first character at or after p that isn't in cls
+    template <std::uint8_t cls>
+    char const * skip_class(char const * p, char const * last) noexcept {
+#if ESQUEMA_LEXER_SIMD
+        while (last - p >= ESQUEMA_LEXER_SIMD) {
+            auto mask = cls == Space ? space_bits(load(p)) : subsequent_bits(load(p));
+            if (mask != all_ones) {
+                return p + std::countr_one(mask);
             }
 
-            cur = peek();
+            p += ESQUEMA_LEXER_SIMD;
+        }
+#endif
+        while (p != last && has(*p, cls)) {
+            ++p;
         }
 
-        else if (*cur == ';') {
-            consume_comment();
-            consume_ws();
-            if (is_eof()) {
-                return Token{Token::Type::Eof};
+        return p;
+    }
+}
+
+namespace esquema {
+    Token Lexer::next() {
+        // Any mix of whitespace and comments goes before a token
+        while (!is_eof()) {
+            if (has(*m_cursor, Space)) {
+                consume_ws();
+            }
+
+            else if (*m_cursor == ';') {
+                consume_comment();
+            }
+
+            else {
+                break;
             }
+        }
 
-            cur = peek();
+        if (is_eof()) {
+            return Token{Token::Type::Eof};
         }
 
-        if (is_initial_id(*cur)) {
+        auto c = *m_cursor;
+        if (is_initial_id(c)) {
             return scan_id();
         }
 
-        else if (is_number(*cur)) {
+        else if (is_number(c)) {
             return scan_number();
         }
 
         else {
-            return scan_symbol(); 
+            return scan_symbol();
         }
     }
 
@@ -53,8 +187,7 @@ namespace esquema {
     // for the definition of an identifier
     Token Lexer::scan_id() {
         auto anchor = m_cursor;
-        advance();
-        advance_while(is_subsequent_id);
+        advance_to(skip_class<Subsequent>(m_cursor + 1, m_last));
         return Token{Token::Type::Id, std::string_view(anchor, m_cursor)};
     }
 
@@ -62,71 +195,70 @@ namespace esquema {
     // recognizes the following: (+/-)?123, (+/-)?0.123, (+/-)?.123
     Token Lexer::scan_number() {
         auto anchor = m_cursor;
-        auto c = peek();
-        auto tmp = *this;
-        switch (*c) {
+        auto pos = m_cursor;
+        auto skip_digits = [this] (char const * p) {
+            while (p != m_last && has(*p, Digit)) {
+                ++p;
+            }
+
+            return p;
+        };
+
+        switch (*pos) {
             case '+': case '-': case '.':
-                advance();
-                c = peek();
-                if (!(c && (std::isdigit(*c) || *c == '.'))) {
-                    *this = tmp;
+                ++pos;
+                if (!(pos != m_last && (has(*pos, Digit) || *pos == '.'))) {
                     return scan_id();
                 }
 
                 [[fallthrough]];
             default:
-                advance();
-                advance_while([] (char c) { return std::isdigit(c); });
-                c = peek();
-                if (c && *c == '.') {
-                    advance();
-                    advance_while([] (char c) { return std::isdigit(c); });
+                pos = skip_digits(pos + 1);
+                if (pos != m_last && *pos == '.') {
+                    pos = skip_digits(pos + 1);
                 }
         }
 
+        advance_to(pos);
         return Token{Token::Type::Num, std::string_view(anchor, m_cursor)};
     }
 
     // TODO - rename this member function because I completely forgot that
     // symbols are a thing in scheme. Rename to scan_punc or something like
-    // that. 
+    // that.
 
     // Scans characters that aren't initially part of a number or id
     // throws if the character isn't recognized.
     Token Lexer::scan_symbol() {
-        auto c = peek();
-        if (*c == '(') {
-            advance();
+        auto c = *m_cursor;
+        if (c == '(') {
+            advance_to(m_cursor + 1);
             return Token{Token::Type::LPar};
         }
 
-        else if (*c == ')') {
-            advance();
+        else if (c == ')') {
+            advance_to(m_cursor + 1);
             return Token{Token::Type::RPar};
         }
 
-        else if (*c == '#') {
+        else if (c == '#') {
             auto const * anchor = m_cursor;
-            auto row = m_row;
-            auto col = m_col;
-            advance();
-            c = peek();
-            if (c && is_bool(*c)) {
-                advance();
+            if (m_cursor + 1 != m_last && is_bool(m_cursor[1])) {
+                advance_to(m_cursor + 2);
                 return Token{Token::Type::Bool, std::string_view(anchor, m_cursor)};
             }
 
             std::ostringstream msg{};
             msg << "Encountered unknown character '#' near "
-                << row << '-' << col;
-            
+                << m_row << '-' << m_col;
+
             throw std::runtime_error{msg.str()};
         }
 
         else {
             std::ostringstream msg{};
             msg << "Encountered unknown character '"
-                << *c << "' near " << m_row << '-' 
+                << c << "' near " << m_row << '-'
                 << m_col;
 
             throw std::runtime_error{msg.str()};
@@ -135,90 +267,86 @@ namespace esquema {
 
     // Tests if the character can be the start of an identifier
     bool Lexer::is_initial_id(char c) noexcept {
-        return std::isalpha(c) ||
-               c == '!' || c == '$' || c == '%' || c == '&' ||
-               c == '*' || c == '/' || c == ':' || c == '<' || 
-               c == '=' || c == '>' || c == '?' || c == '~' || 
-               c == '_' || c == '^';
+        return has(c, Initial);
     }
 
     // Tests if the charcter can be the subsequent letters
     // of an identifier
     bool Lexer::is_subsequent_id(char c) noexcept {
-        return std::isalnum(c) ||
-               c == '!' || c == '$' || c == '%' || c == '&' ||
-               c == '*' || c == '/' || c == ':' || c == '<' ||
-               c == '=' || c == '>' || c == '?' || c == '~' || 
-               c == '_' || c == '^' || c == '.' || c == '+' || 
-               c == '-';
+        return has(c, Subsequent);
     }
 
     // Tests if the character can start a number
     bool Lexer::is_number(char c) noexcept {
-        return std::isdigit(c) || c == '+' || c == '-' || c == '.';
+        return has(c, NumStart);
     }
 
     // These are the valid characters for a boolean
     bool Lexer::is_bool(char c) noexcept {
-        switch (c) {
-            case 't': case 'T': case 'f': case 'F':
-                return true;
-            default:
-                return false;
-        }
+        return has(c, BoolChar);
     }
 
     void Lexer::consume_ws() noexcept {
-        // We've already seen a ws character;
-        advance();
-        advance_while([](char c){ return std::isspace(c); });
+        skip_to(skip_class<Space>(m_cursor, m_last));
     }
 
+    // The newline is left for consume_ws, memchr is about as fast
+    // as it gets for finding it
     void Lexer::consume_comment() noexcept {
-        // We've already seen the semicolon
-        advance();
-        advance_while([](char c) { return c != '\n'; });
+        auto eol = static_cast<char const *>(
+            std::memchr(m_cursor, '\n', static_cast<std::size_t>(m_last - m_cursor))
+        );
+
+        advance_to(eol ? eol : m_last);
     }
 
     bool Lexer::is_eof() const noexcept {
         return m_cursor == m_last;
     }
 
-    std::optional<char> Lexer::peek() const noexcept {
-        if (!is_eof()) {
-            return std::optional{*m_cursor};
+    // Moves up to pos which must not be past a newline. Tokens and
+    // comments never contain one so this is just column arithmetic.
+    void Lexer::advance_to(char const * pos) noexcept {
+        m_col += static_cast<int>(pos - m_cursor);
+        m_cursor = pos;
+    }
+
+    // Moves up to pos doing the row and column bookkeeping for any
+    // newlines along the way. No attempt is made to handle Windows
+    // line endings.
+    void Lexer::skip_to(char const * pos) noexcept {
+        auto newlines = std::count(m_cursor, pos, '\n');
+        if (newlines == 0) {
+            m_col += static_cast<int>(pos - m_cursor);
         }
 
         else {
-            return {};
+            auto rlast = std::find(
+                std::make_reverse_iterator(pos),
+                std::make_reverse_iterator(m_cursor),
+                '\n'
+            );
+
+            m_row += static_cast<int>(newlines);
+            m_col = static_cast<int>(pos - (rlast.base() - 1));
         }
-    }
 
-    // May shift the buffer pointer as long as there is
-    // runway left. It also does row and column bookkeeping
-    // No attempt is made to handle Windows line endings.
-    void Lexer::advance() noexcept {
-        if (!is_eof()) {
-            if (auto c = peek(); c && *c == '\n') {
-                ++m_row;
-                m_col = 1;
-            }
-            else {
-                ++m_col;
-            }
-
-            ++m_cursor;
-        }
+        m_cursor = pos;
     }
 
     Lexer::Lexer(std::string_view txt) noexcept
+        : Lexer{txt, 1, 1}
+    { }
+
+    Lexer::Lexer(std::string_view txt, int row, int col) noexcept
         : m_cursor{nullptr}, m_last{nullptr}
         , m_row{-1}, m_col{-1}
     {
         if (!txt.empty()) {
             m_cursor = txt.data();
             m_last = txt.data() + txt.size();
-            m_row = m_col = 1;
+            m_row = row;
+            m_col = col;
         }
     }
 }
@@ -3,7 +3,6 @@
 
 #include "token.hh"
 #include <iosfwd>
-#include <optional>
 #include <string>
 
 namespace esquema {
@@ -16,7 +15,9 @@ namespace esquema {
     // end of the input. Lexers are lightweight to copy so if you need
     // to do lookahead sort of analysis it is as easy as taking a copy
     // and going ahead and when the pattern fails reassign the stashed
-    // Lexer.
+    // Lexer. Characters are classified with a lookup table and runs of
+    // whitespace, comments and identifiers are skipped a vector at a
+    // time where the hardware allows it.
     class Lexer {
     // Interface
     public:
@@ -27,6 +28,10 @@ namespace esquema {
     // Constructors
     public:
         explicit Lexer(std::string_view txt) noexcept;
+
+        // For text that was cut out of a bigger buffer, row and col
+        // are where it starts in that buffer
+        Lexer(std::string_view txt, int row, int col) noexcept;
         constexpr Lexer() noexcept
             : m_cursor{nullptr}, m_last{nullptr}
             , m_row{-1}, m_col{-1}
@@ -35,19 +40,8 @@ namespace esquema {
     // Helpers
     private:
         bool is_eof() const noexcept;
-        std::optional<char> peek() const noexcept;
-        void advance() noexcept;
-        template <typename P>
-        void advance_while(P && pred) noexcept {
-            while (true) {
-                auto cur = peek();
-                if (!(cur && pred(*cur))) {
-                    break;
-                }
-
-                advance();
-            }
-        }
+        void advance_to(char const * pos) noexcept;
+        void skip_to(char const * pos) noexcept;
 
     private:
         void consume_ws() noexcept;
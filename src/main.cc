@@ -1,6 +1,11 @@
+#include "form_reader.hh"
 #include "interp.hh"
 #include "linenoise.hpp"
+#include "mapped_file.hh"
+#include "parser.hh"
 #include <exception>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
 #include <string>
 
@@ -8,35 +13,109 @@ namespace {
     using namespace std::literals::string_view_literals;
     using namespace std::literals::string_literals;
     using namespace esquema;
+
+    // Runs a file a form at a time without printing anything, the
+    // first error stops it. Regular files are mapped, anything else
+    // like a pipe or '-' for standard input is streamed.
+    int run_file(Interpreter & interpreter, std::string const & path) {
+        try {
+            auto run = [&interpreter] (FormReader & reader) {
+                while (auto form = reader.next()) {
+                    interpreter.eval_form(*form);
+                }
+            };
+
+            if (path == "-"sv) {
+                FormReader reader{std::cin};
+                run(reader);
+            }
+
+            else if (std::filesystem::is_regular_file(path)) {
+                MappedFile file{path};
+                FormReader reader{file};
+                run(reader);
+            }
+
+            else {
+                std::ifstream in{path, std::ios::binary};
+                if (!in) {
+                    std::cerr << "Couldn't open '"sv << path << "'\n"sv;
+                    return EXIT_FAILURE;
+                }
+
+                FormReader reader{in};
+                run(reader);
+            }
+        }
+
+        catch (std::exception const & ex) {
+            std::cerr << path << ": "sv << ex.what() << '\n';
+            return EXIT_FAILURE;
+        }
+
+        return EXIT_SUCCESS;
+    }
 }
 
 int main(int argc, char ** argv) {
-    Interpreter interpreter{};
+    // The tree walker is kept around as the reference engine
+    // so you can check the VM against it
+    auto engine = Interpreter::Engine::Bytecode;
+    char const * path = nullptr;
+    for (auto i = 1; i < argc; ++i) {
+        if (argv[i] == "--tree-walker"sv) {
+            engine = Interpreter::Engine::TreeWalker;
+        }
+
+        else if ((argv[i][0] != '-' || argv[i] == "-"sv) && !path) {
+            path = argv[i];
+        }
+
+        else {
+            std::cerr << "Unknown option '"sv << argv[i] << "'\n"sv;
+            return EXIT_FAILURE;
+        }
+    }
+
+    Interpreter interpreter{engine};
+    if (path) {
+        return run_file(interpreter, path);
+    }
+
+    // Lines go to the parser as they come in, an expression can
+    // go over as many lines as it likes and a line can hold as
+    // many expressions as it likes
+    Parser reader{};
     std::string line;
     std::cout << "Bienvenidos to the Esquema REPL \n"sv
               << "type an expression to evaluate or type \n"sv 
               << "':q' or use 'Ctrl+c' to quit\n"sv
               << "----------------------------------------\n\n"sv;
     while (true) {
-        auto quit = linenoise::Readline("esquema> ", line);
+        auto prompt = reader.incomplete() ? "   ...> " : "esquema> ";
+        auto quit = linenoise::Readline(prompt, line);
         if (quit) {
             break;
         }
 
-        if (line.empty()) {
+        if (line.empty() && !reader.incomplete()) {
             continue;
         }
         // TODO - This is like Haskell's REPL
         // Scheme might do it some other way.
-        else if (line == ":q"sv) {
+        else if (line == ":q"sv && !reader.incomplete()) {
             break;
         }
 
         try {
-            std::cout << interpreter.eval(line) << '\n';
+            line += '\n';
+            for (auto const & form : reader.feed(line)) {
+                std::cout << interpreter.eval_form(form) << '\n';
+            }
         }
 
         catch (std::exception const & ex) {
+            reader.discard();
             std::cerr << ex.what() << '\n';
         }
         catch (...) {
@@ -0,0 +1,79 @@
+#include "mapped_file.hh"
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+    using namespace std::literals::string_view_literals;
+
+    [[noreturn]] void fail(std::string_view what, std::string const & path, int err) {
+        std::ostringstream msg{};
+        msg << "Couldn't "sv << what << " '"sv << path
+            << "': "sv << std::strerror(err);
+
+        throw std::runtime_error{msg.str()};
+    }
+}
+
+namespace esquema {
+    std::string_view MappedFile::text() const noexcept {
+        return {m_data, m_size};
+    }
+
+    void MappedFile::release(char const * pos) noexcept {
+        auto const page = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+        auto upto = static_cast<std::size_t>(pos - m_data) / page * page;
+        if (upto > m_released) {
+            ::madvise(
+                const_cast<char *>(m_data) + m_released,
+                upto - m_released, MADV_DONTNEED
+            );
+
+            m_released = upto;
+        }
+    }
+
+    MappedFile::MappedFile(std::string const & path)
+        : m_data{nullptr}, m_size{0}, m_released{0}
+    {
+        auto fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            fail("open"sv, path, errno);
+        }
+
+        struct stat info{};
+        if (::fstat(fd, &info) != 0) {
+            auto err = errno;
+            ::close(fd);
+            fail("stat"sv, path, err);
+        }
+
+        // Nothing to map in an empty file and mmap won't do it anyway
+        m_size = static_cast<std::size_t>(info.st_size);
+        if (m_size != 0) {
+            auto addr = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (addr == MAP_FAILED) {
+                auto err = errno;
+                ::close(fd);
+                fail("map"sv, path, err);
+            }
+
+            m_data = static_cast<char const *>(addr);
+            ::madvise(addr, m_size, MADV_SEQUENTIAL);
+        }
+
+        // The mapping keeps the file around on its own
+        ::close(fd);
+    }
+
+    MappedFile::~MappedFile() {
+        if (m_data) {
+            ::munmap(const_cast<char *>(m_data), m_size);
+        }
+    }
+}
@@ -0,0 +1,38 @@
+#ifndef ESQUEMA_MAPPED_FILE_HH_INCLUDED
+#define ESQUEMA_MAPPED_FILE_HH_INCLUDED
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace esquema {
+    // A source file mapped read-only into memory. The Lexer works on
+    // the mapping directly, nothing is read into a string first, and
+    // the pages come in from the file as the Lexer gets to them.
+    // Pipes and terminals can't be mapped, use a FormReader on the
+    // stream for those.
+    class MappedFile {
+    // Interface
+    public:
+        std::string_view text() const noexcept;
+
+        // Lets the kernel drop the pages before pos, we won't be
+        // looking at them again
+        void release(char const * pos) noexcept;
+
+    // Constructors
+    public:
+        explicit MappedFile(std::string const & path);
+        MappedFile(MappedFile const &) = delete;
+        MappedFile & operator=(MappedFile const &) = delete;
+        ~MappedFile();
+
+    // Data
+    private:
+        char const * m_data;
+        std::size_t m_size;
+        std::size_t m_released;
+    };
+}
+
+#endif
@@ -1,6 +1,8 @@
 #include "native_proc.hh"
-#include "environ.hh"
+#include "bigint.hh"
 
+#include <cstdint>
+#include <optional>
 #include <sstream>
 #include <stdexcept>
 #include <limits>
@@ -10,36 +12,158 @@ namespace {
     // really late at night and I wanted to finish so
     // this is what came out. Please don't judge me too
     // harshly.
+    bool is_exact(esquema::Value value) noexcept {
+        return value.is_fixnum() || value.is_bignum();
+    }
+
+    // Fixnums, bignums and doubles all count
+    double to_double(esquema::Value value) {
+        if (value.is_fixnum()) {
+            return static_cast<double>(value.fixnum());
+        }
+        else if (value.is_bignum()) {
+            return value.bignum()->value().to_double();
+        }
+        else if (!value.is_number()) {
+            throw std::runtime_error{"Type error: expected number"};
+        }
+
+        return value.number();
+    }
+
+    // This one has to be exact
+    esquema::BigInt to_bigint(esquema::Value value) {
+        return value.is_fixnum() ? esquema::BigInt{value.fixnum()} : value.bignum()->value();
+    }
+
+    // One look at the tag per element and the running
+    // total never leaves a register
     template <typename It, typename Op>
-    esquema::Cell acc_op(It it, It last, double acc, Op op) {
+    esquema::Value acc_op(It it, It last, double acc, Op op) {
+        while (it != last) {
+            acc = op(acc, to_double(*it++));
+        }
+
+        return esquema::Number{acc};
+    }
+
+    // Where exact_acc_op goes once the total won't fit in a fixnum or
+    // there's a bignum to add in. It stays exact until a double comes
+    // along, and goes back to being a fixnum at the end if it can.
+    template <typename It, typename BigOp, typename Op>
+    esquema::Value big_acc_op(It it, It last, esquema::BigInt acc, BigOp big_op, Op op, esquema::Heap & heap) {
         while (it != last) {
-            auto const & cell = *it++;
-            if (!cell.is_number()) {
-                throw std::runtime_error{"Type error: expected number"};
+            auto value = *it;
+            if (value.is_fixnum()) {
+                acc = big_op(acc, esquema::BigInt{value.fixnum()});
             }
+            else if (value.is_bignum()) {
+                acc = big_op(acc, value.bignum()->value());
+            }
+            else {
+                return acc_op(it, last, acc.to_double(), op);
+            }
+            ++it;
+        }
+
+        return esquema::Value::from_integer(std::move(acc), heap);
+    }
 
-            acc = op(acc, std::get<esquema::Number>(cell).value());
+    // Same again, but the total stays a fixnum for as long as every
+    // argument is one and int_op, which works like __builtin_add_overflow
+    // and friends, doesn't overflow. Past that it's a bignum, and from
+    // the first double on it's all floating point.
+    template <typename It, typename IntOp, typename BigOp, typename Op>
+    esquema::Value exact_acc_op(
+        It it, It last, std::int64_t acc,
+        IntOp int_op, BigOp big_op, Op op, esquema::Heap & heap
+    ) {
+        while (it != last) {
+            auto value = *it;
+            auto result = std::int64_t{0};
+            if (!value.is_fixnum() || int_op(acc, value.fixnum(), &result)
+                || !esquema::Value::fits_fixnum(result)) {
+                if (is_exact(value)) {
+                    return big_acc_op(it, last, esquema::BigInt{acc}, big_op, op, heap);
+                }
+
+                return acc_op(it, last, static_cast<double>(acc), op);
+            }
+
+            acc = result;
+            ++it;
         }
 
-        return esquema::Number{acc};
+        return esquema::Value::from_fixnum(acc);
+    }
+
+    // Fixnums and doubles, the numbers the fast versions take
+    bool is_small(esquema::Value value) noexcept {
+        return value.is_fixnum() || value.is_number();
+    }
+
+    double small_to_double(esquema::Value value) noexcept {
+        return value.is_fixnum() ? static_cast<double>(value.fixnum()) : value.number();
+    }
+
+    // The double versions go through the same steps the builtins'
+    // running totals do, starting from 0 or 1, so even the sign of a
+    // zero comes out the same
+    template <typename IntOp, typename Op>
+    std::optional<esquema::Value> fast_acc_op(
+        esquema::Value lhs, esquema::Value rhs, std::int64_t init, IntOp int_op, Op op
+    ) noexcept {
+        if (lhs.is_fixnum() && rhs.is_fixnum()) {
+            auto acc = std::int64_t{0};
+            if (int_op(init, lhs.fixnum(), &acc) || int_op(acc, rhs.fixnum(), &acc)
+                || !esquema::Value::fits_fixnum(acc)) {
+                return {};
+            }
+
+            return esquema::Value::from_fixnum(acc);
+        }
+
+        if (!is_small(lhs) || !is_small(rhs)) {
+            return {};
+        }
+
+        auto acc = op(static_cast<double>(init), small_to_double(lhs));
+        return esquema::Value{esquema::Number{op(acc, small_to_double(rhs))}};
     }
 
+    template <typename Op>
+    std::optional<esquema::Value> fast_rel_op(esquema::Value lhs, esquema::Value rhs, Op op) noexcept {
+        if (lhs.is_fixnum() && rhs.is_fixnum()) {
+            return esquema::Value{esquema::Bool{op(lhs.fixnum(), rhs.fixnum())}};
+        }
+
+        if (!is_small(lhs) || !is_small(rhs)) {
+            return {};
+        }
+
+        return esquema::Value{esquema::Bool{op(small_to_double(lhs), small_to_double(rhs))}};
+    }
+
+    // Two fixnums get compared as they are, other exact numbers as
+    // bignums and anything else as doubles. A fixnum always fits in a
+    // double exactly so for those it's the same answer either way,
+    // the first one is just cheaper.
     template <typename It, typename Op>
-    esquema::Cell map_rel_op(It it, It last, Op op) {
+    esquema::Value map_rel_op(It it, It last, Op op) {
         auto prev = *it++;
-        if (!prev.is_number()) {
+        if (!is_exact(prev) && !prev.is_number()) {
             throw std::runtime_error{"Type error: expected number"};
         }
 
         while (it != last) {
             auto next = *it++;
-            if (!next.is_number()) {
-                throw std::runtime_error{"Type error: expected number"};
-            }
+            auto holds = prev.is_fixnum() && next.is_fixnum()
+                ? op(prev.fixnum(), next.fixnum())
+                : is_exact(prev) && is_exact(next)
+                ? op(to_bigint(prev), to_bigint(next))
+                : op(to_double(prev), to_double(next));
 
-            auto lhs = std::get<esquema::Number>(prev).value();
-            auto rhs = std::get<esquema::Number>(next).value();
-            if (!op(lhs, rhs)) {
+            if (!holds) {
                 return esquema::Bool{false};
             }
             prev = next;
@@ -50,51 +174,72 @@ namespace {
 }
 
 namespace esquema {
-    Cell add(List const & args, Environment * env) {
+    Value add(std::span<Value const> args, Heap & heap) {
         if (args.empty()) {
             throw std::runtime_error{"Too few arguments, + needs at least two"};
         }
 
-        return acc_op(
-            args.begin(), args.end(), 
-            0.0D, 
+        return exact_acc_op(
+            args.begin(), args.end(),
+            std::int64_t{0},
+            [] (std::int64_t lhs, std::int64_t rhs, std::int64_t * result) {
+                return __builtin_add_overflow(lhs, rhs, result);
+            },
+            [] (BigInt const & lhs, BigInt const & rhs) {
+                return lhs + rhs;
+            },
             [] (double lhs, double rhs) {
                 return lhs + rhs;
-            }
-        ); 
+            },
+            heap
+        );
     }
 
-    Cell sub(List const & args, Environment * env) {
+    Value sub(std::span<Value const> args, Heap & heap) {
         if (args.size() < 2) {
             throw std::runtime_error{"Too few arguments: - requires at least two"};
         }
 
-        return acc_op(
+        return exact_acc_op(
             args.begin(), args.end(),
-            0.0D,
+            std::int64_t{0},
+            [] (std::int64_t lhs, std::int64_t rhs, std::int64_t * result) {
+                return __builtin_sub_overflow(lhs, rhs, result);
+            },
+            [] (BigInt const & lhs, BigInt const & rhs) {
+                return lhs - rhs;
+            },
             [] (double lhs, double rhs) {
                 return lhs - rhs;
-            }
+            },
+            heap
         );
     }
 
-    Cell mul(List const & args, Environment * env) {
+    Value mul(std::span<Value const> args, Heap & heap) {
         if (args.size() < 2) {
             throw std::runtime_error{"Too few arguments: * requires at least two"};
         }
 
-        return acc_op(
+        return exact_acc_op(
             args.begin(), args.end(),
-            1.0D,
+            std::int64_t{1},
+            [] (std::int64_t lhs, std::int64_t rhs, std::int64_t * result) {
+                return __builtin_mul_overflow(lhs, rhs, result);
+            },
+            [] (BigInt const & lhs, BigInt const & rhs) {
+                return lhs * rhs;
+            },
             [] (double lhs, double rhs) {
                 return lhs * rhs;
-            }
+            },
+            heap
         );
     }
 
     // TODO - I think there's something wrong with this one
     // I know division is a tricky operation
-    Cell div(List const & args, Environment * env) {
+    Value div(std::span<Value const> args, Heap & heap) {
         if (args.size() < 2) {
             throw std::runtime_error{"Too few arguments: / requires at least two"};
         }
@@ -111,53 +256,53 @@ namespace esquema {
         );
     }
 
-    Cell less(List const & args, Environment * env) {
+    Value less(std::span<Value const> args, Heap & heap) {
         if (args.size() < 2) {
             throw std::runtime_error{"Too few arguments: < requires at least two"};
         }
 
         return map_rel_op(
             args.begin(), args.end(),
-            [] (double lhs, double rhs) {
+            [] (auto lhs, auto rhs) {
                 return lhs < rhs;
             }
         );
     }
 
-    Cell less_equal(List const & args, Environment * env) {
+    Value less_equal(std::span<Value const> args, Heap & heap) {
         if (args.size() < 2) {
             throw std::runtime_error{"Too few arguments: <= requires at least two"};
         }
 
         return map_rel_op(
             args.begin(), args.end(),
-            [] (double lhs, double rhs) {
+            [] (auto lhs, auto rhs) {
                 return lhs <= rhs;
             }
         );
     }
 
-    Cell greater(List const & args, Environment * env) {
+    Value greater(std::span<Value const> args, Heap & heap) {
         if (args.size() < 2) {
             throw std::runtime_error{"Too few arguments: > requires at least two"};
         }
 
         return map_rel_op(
             args.begin(), args.end(),
-            [] (double lhs, double rhs) {
+            [] (auto lhs, auto rhs) {
                 return lhs > rhs;
             }
         );
     }
 
-    Cell greater_equal(List const & args, Environment * env) {
+    Value greater_equal(std::span<Value const> args, Heap & heap) {
         if (args.size() < 2) {
             throw std::runtime_error{"Too few arguments: >= requires at least two"};
         }
 
         return map_rel_op(
             args.begin(), args.end(),
-            [] (double lhs, double rhs) {
+            [] (auto lhs, auto rhs) {
                 return lhs >= rhs;
             }
         );
@@ -165,29 +310,43 @@ namespace esquema {
 
     // The definition of equivalence in Scheme is here:
     // https://conservatory.scheme.org/schemers/Documents/Standards/R5RS/HTML/r5rs-Z-H-9.html#%_sec_6.1
-    Cell equal(List const & args, Environment * env) {
+    Value equal(std::span<Value const> args, Heap & heap) {
         if (args.size() != 2) {
             throw std::runtime_error{"eqv? takes exactly two arguments"};
         }
 
-        auto it = args.begin();
-        auto lhs = *it++;
-        auto rhs = *it++;
+        auto lhs = args[0];
+        auto rhs = args[1];
         auto result = false;
-        if (lhs.is_bool() && rhs.is_bool()) {
-            result = std::get<Bool>(lhs).value() == std::get<Bool>(rhs).value();
+        if (is_exact(lhs) && is_exact(rhs)) {
+            result = lhs.is_fixnum() && rhs.is_fixnum()
+                ? lhs.fixnum() == rhs.fixnum()
+                : lhs.is_bignum() && rhs.is_bignum() && lhs.bignum()->value() == rhs.bignum()->value();
+        }
+
+        // An exact number is never eqv? to an inexact one
+        else if (lhs.is_number() && rhs.is_number()) {
+            result = lhs.number() == rhs.number();
+        }
+
+        else if (lhs.is_bool() && rhs.is_bool()) {
+            result = lhs.boolean() == rhs.boolean();
         }
 
         else if (lhs.is_symbol() && rhs.is_symbol()) {
-            result = std::get<Symbol>(lhs).value() == std::get<Symbol>(rhs).value();
+            result = lhs.symbol() == rhs.symbol();
         }
 
         else if (lhs.is_nil() && rhs.is_nil()) {
             result = true;
         }
 
-        else if (lhs.is_proc() && rhs.is_proc()) {
-            result = &std::get<Proc>(lhs) == &std::get<Proc>(rhs);
+        // The same proc, closure or pair, not two that happen to look
+        // alike. Those are just their addresses in a Value, and the
+        // empty list is always the same one.
+        else if ((lhs.is_native() && rhs.is_native()) || (lhs.is_closure() && rhs.is_closure())
+            || (lhs.is_object() && rhs.is_object())) {
+            result = lhs.bits() == rhs.bits();
         }
 
         return Bool{result};
@@ -195,7 +354,7 @@ namespace esquema {
 
     // How Scheme coerces types into Booleans is detailed here
     // https://conservatory.scheme.org/schemers/Documents/Standards/R5RS/HTML/r5rs-Z-H-9.html#%_sec_6.3.1
-    Cell negate(List const & args, Environment * env) {
+    Value negate(std::span<Value const> args, Heap & heap) {
         if (args.size() != 1) {
             throw std::runtime_error{"not? takes just one argument"};
         }
@@ -203,9 +362,144 @@ namespace esquema {
         auto rhs = args.front();
         auto result = false;
         if (rhs.is_bool()) {
-            result = !std::get<Bool>(rhs).value();
+            result = !rhs.boolean();
         }
 
         return Bool{result};
-    }                                       
+    }
+
+    // The cdr of a pair is always a list here, so there are
+    // no dotted pairs and (cons 1 2) is an error
+    Value cons(std::span<Value const> args, Heap & heap) {
+        if (args.size() != 2) {
+            throw std::runtime_error{"cons takes exactly two arguments"};
+        }
+
+        if (!args[1].is_list()) {
+            throw std::runtime_error{"cons requires a list as its second argument"};
+        }
+
+        return heap.make<PairObject>(args[0], args[1]);
+    }
+
+    Value car(std::span<Value const> args, Heap & heap) {
+        if (args.size() != 1) {
+            throw std::runtime_error{"car takes just one argument"};
+        }
+
+        if (!args[0].is_pair()) {
+            throw std::runtime_error{"car requires a non-empty list"};
+        }
+
+        return args[0].pair()->car();
+    }
+
+    Value cdr(std::span<Value const> args, Heap & heap) {
+        if (args.size() != 1) {
+            throw std::runtime_error{"cdr takes just one argument"};
+        }
+
+        if (!args[0].is_pair()) {
+            throw std::runtime_error{"cdr requires a non-empty list"};
+        }
+
+        return args[0].pair()->cdr();
+    }
+
+    Value list(std::span<Value const> args, Heap & heap) {
+        auto result = Value::empty_list();
+        for (auto it = args.rbegin(); it != args.rend(); ++it) {
+            result = heap.make<PairObject>(*it, result);
+        }
+
+        return result;
+    }
+
+    // Every pair knows its length so this doesn't walk the list
+    Value length(std::span<Value const> args, Heap & heap) {
+        if (args.size() != 1) {
+            throw std::runtime_error{"length takes just one argument"};
+        }
+
+        if (!args[0].is_list()) {
+            throw std::runtime_error{"length requires a list"};
+        }
+
+        auto n = args[0].is_pair() ? args[0].pair()->length() : 0;
+        return Number::from_integer(static_cast<std::int64_t>(n));
+    }
+
+    Value call_proc(Proc proc, std::span<Value const> args, Environment * env, Heap & heap) {
+        List list{};
+        list.reserve(args.size());
+        for (auto const & arg : args) {
+            list.push_back(arg.to_cell());
+        }
+
+        return Value::from_cell(proc(list, env), heap);
+    }
+
+    std::optional<Value> fast::add(Value lhs, Value rhs) noexcept {
+        return fast_acc_op(lhs, rhs, 0,
+            [] (std::int64_t lhs, std::int64_t rhs, std::int64_t * result) {
+                return __builtin_add_overflow(lhs, rhs, result);
+            },
+            [] (double lhs, double rhs) {
+                return lhs + rhs;
+            }
+        );
+    }
+
+    std::optional<Value> fast::sub(Value lhs, Value rhs) noexcept {
+        return fast_acc_op(lhs, rhs, 0,
+            [] (std::int64_t lhs, std::int64_t rhs, std::int64_t * result) {
+                return __builtin_sub_overflow(lhs, rhs, result);
+            },
+            [] (double lhs, double rhs) {
+                return lhs - rhs;
+            }
+        );
+    }
+
+    std::optional<Value> fast::mul(Value lhs, Value rhs) noexcept {
+        return fast_acc_op(lhs, rhs, 1,
+            [] (std::int64_t lhs, std::int64_t rhs, std::int64_t * result) {
+                return __builtin_mul_overflow(lhs, rhs, result);
+            },
+            [] (double lhs, double rhs) {
+                return lhs * rhs;
+            }
+        );
+    }
+
+    // Dividing by zero is left to the builtin, it knows what to say
+    std::optional<Value> fast::div(Value lhs, Value rhs) noexcept {
+        if (!is_small(lhs) || !is_small(rhs)) {
+            return {};
+        }
+
+        auto const x = small_to_double(lhs);
+        auto const y = small_to_double(rhs);
+        if (x == 0.0 || y == 0.0) {
+            return {};
+        }
+
+        return Value{Number{1.0 / x / y}};
+    }
+
+    std::optional<Value> fast::less(Value lhs, Value rhs) noexcept {
+        return fast_rel_op(lhs, rhs, [] (auto lhs, auto rhs) { return lhs < rhs; });
+    }
+
+    std::optional<Value> fast::less_equal(Value lhs, Value rhs) noexcept {
+        return fast_rel_op(lhs, rhs, [] (auto lhs, auto rhs) { return lhs <= rhs; });
+    }
+
+    std::optional<Value> fast::greater(Value lhs, Value rhs) noexcept {
+        return fast_rel_op(lhs, rhs, [] (auto lhs, auto rhs) { return lhs > rhs; });
+    }
+
+    std::optional<Value> fast::greater_equal(Value lhs, Value rhs) noexcept {
+        return fast_rel_op(lhs, rhs, [] (auto lhs, auto rhs) { return lhs >= rhs; });
+    }
 }
@@ -2,26 +2,60 @@
 #define ESQUEMA_NATIVE_PROCS_HH_INCLUDED
 
 #include "ast.hh"
+#include "heap.hh"
+#include "value.hh"
+#include <optional>
+#include <span>
 
 namespace esquema {
     // Here we have the builtin procedures that
     // come with the default global environment
     // There are many many many of them, so here
-    // are some of the ones I think are most important
+    // are some of the ones I think are most important.
+    // They're all Natives, see ast.hh
     class Environment;
-    Cell add(List const & args, Environment * env);
-    Cell sub(List const & args, Environment * env);
-    Cell mul(List const & args, Environment * env);
-    Cell div(List const & args, Environment * env);
-    Cell less(List const & args, Environment * env);
-    Cell less_equal(List const & args, Environment * env);
-    Cell greater(List const & args, Environment * env);
-    Cell greater_equal(List const & args, Environment * env);
+    Value add(std::span<Value const> args, Heap & heap);
+    Value sub(std::span<Value const> args, Heap & heap);
+    Value mul(std::span<Value const> args, Heap & heap);
+    Value div(std::span<Value const> args, Heap & heap);
+    Value less(std::span<Value const> args, Heap & heap);
+    Value less_equal(std::span<Value const> args, Heap & heap);
+    Value greater(std::span<Value const> args, Heap & heap);
+    Value greater_equal(std::span<Value const> args, Heap & heap);
 
     // TODO - Rename this to equivalent because that is
     // what it is doing
-    Cell equal(List const & args, Environment * env);
-    Cell negate(List const & args, Environment * env);
+    Value equal(std::span<Value const> args, Heap & heap);
+    Value negate(std::span<Value const> args, Heap & heap);
+
+    // Lists, see PairObject
+    Value cons(std::span<Value const> args, Heap & heap);
+    Value car(std::span<Value const> args, Heap & heap);
+    Value cdr(std::span<Value const> args, Heap & heap);
+    Value list(std::span<Value const> args, Heap & heap);
+    Value length(std::span<Value const> args, Heap & heap);
+
+    // The shim for procs with the old calling convention, the
+    // arguments are copied into a List and the result back out
+    Value call_proc(Proc proc, std::span<Value const> args, Environment * env, Heap & heap);
+
+    // Most calls of the arithmetic and relational builtins have two
+    // arguments that are fixnums or doubles, these are those calls
+    // and nothing else. They give exactly the answer the builtin
+    // would. Anything else, a bignum, a result that won't fit in a
+    // fixnum, an argument that isn't a number at all, is nullopt and
+    // the builtin has to be called after all. The VM has an
+    // instruction for each of them, see Op.
+    namespace fast {
+        std::optional<Value> add(Value lhs, Value rhs) noexcept;
+        std::optional<Value> sub(Value lhs, Value rhs) noexcept;
+        std::optional<Value> mul(Value lhs, Value rhs) noexcept;
+        std::optional<Value> div(Value lhs, Value rhs) noexcept;
+        std::optional<Value> less(Value lhs, Value rhs) noexcept;
+        std::optional<Value> less_equal(Value lhs, Value rhs) noexcept;
+        std::optional<Value> greater(Value lhs, Value rhs) noexcept;
+        std::optional<Value> greater_equal(Value lhs, Value rhs) noexcept;
+    }
 }
 
 #endif
@@ -0,0 +1,332 @@
+#include "optimizer.hh"
+#include "builtins.hh"
+#include "closure.hh"
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+    using namespace esquema;
+
+    bool is_form(Cell const & cell, std::uint32_t keyword) noexcept {
+        auto const * list = std::get_if<List>(&cell);
+        auto const * head = list && !list->empty() ? std::get_if<Symbol>(&list->front()) : nullptr;
+        return head && head->id() == keyword;
+    }
+
+    bool is_builtin(Symbol const & sym) noexcept {
+        return builtin_index(sym.id()) != builtins.size();
+    }
+
+    // Evaluating one of these can't do anything but hand it back
+    bool is_literal(Cell const & cell) noexcept {
+        return cell.is_number() || cell.is_bool() || cell.is_nil();
+    }
+
+    // An inner begin is spliced into the one around it, unless it's
+    // the last form and empty, its value is the begin's value then
+    bool splices(Cell const & cell, bool last) noexcept {
+        return is_form(cell, Symbol::Begin) && (!last || std::get<List>(cell).size() > 1);
+    }
+
+    Cell folded(Cell value, Cell original) {
+        auto const guard = Optimizer::guard(original);
+        List list{};
+        list.reserve(4);
+        list.push_back(Symbol::from_id(Symbol::Folded));
+        list.push_back(std::move(value));
+        list.push_back(std::move(original));
+        list.push_back(Number::from_integer(static_cast<std::int64_t>(guard)));
+        return list;
+    }
+
+    static_assert(builtins.size() < 64, "A guard has a bit for every builtin");
+}
+
+namespace esquema {
+    std::optional<Cell> Optimizer::optimize(Cell const & form, Environment const & env) {
+        m_env = &env;
+        m_shadowed.clear();
+        return rewrite(form);
+    }
+
+    std::optional<List> Optimizer::optimize_all(List const & forms, Environment const & env) {
+        m_env = &env;
+        m_shadowed.clear();
+        return rewrite_from(forms, 0);
+    }
+
+    std::uint64_t Optimizer::guard(Cell const & original) noexcept {
+        if (auto const * sym = std::get_if<Symbol>(&original)) {
+            return is_builtin(*sym) ? std::uint64_t{1} << builtin_index(sym->id()) : 0;
+        }
+
+        auto bits = std::uint64_t{0};
+        if (auto const * list = std::get_if<List>(&original)) {
+            for (auto const & cell : *list) {
+                bits |= guard(cell);
+            }
+        }
+
+        return bits;
+    }
+
+    std::uint64_t Optimizer::hidden(Environment const & env) noexcept {
+        auto bits = std::uint64_t{0};
+        for (auto i = std::size_t{0}; i < builtins.size(); ++i) {
+            if (!env.builtin(Symbol::from_id(first_builtin + static_cast<std::uint32_t>(i)))) {
+                bits |= std::uint64_t{1} << i;
+            }
+        }
+
+        return bits;
+    }
+
+    // Atoms stay as they are, a pure constant on its own is just as
+    // quick to look up as to check. It's the calls it's passed to
+    // that are worth folding.
+    std::optional<Cell> Optimizer::rewrite(Cell const & cell) {
+        auto const * list = std::get_if<List>(&cell);
+        if (!list || list->empty()) {
+            return {};
+        }
+
+        if (auto const * head = std::get_if<Symbol>(&list->front())) {
+            switch (head->id()) {
+                case Symbol::Define: return rewrite_define(*list);
+                case Symbol::If: return rewrite_if(*list);
+                case Symbol::Begin: return rewrite_begin(*list);
+                case Symbol::Lambda: return rewrite_lambda(*list);
+                case Symbol::Folded: return {};
+                default: break;
+            }
+        }
+
+        return rewrite_call(*list);
+    }
+
+    // The copy is only made once the first one changes, the
+    // ones before it are copied over as they were
+    std::optional<List> Optimizer::rewrite_from(List const & list, std::size_t first) {
+        auto out = std::optional<List>{};
+        for (auto i = first; i < list.size(); ++i) {
+            auto cell = rewrite(list[i]);
+            if (cell && !out) {
+                out.emplace();
+                out->reserve(list.size());
+                out->insert(out->end(), list.begin(), list.begin() + static_cast<std::ptrdiff_t>(i));
+            }
+
+            if (out) {
+                out->push_back(cell ? std::move(*cell) : list[i]);
+            }
+        }
+
+        return out;
+    }
+
+    // Malformed special forms are left for the engines to complain
+    // about, they know what to say
+    std::optional<Cell> Optimizer::rewrite_define(List const & list) {
+        if (list.size() != 3 || !list[1].is_symbol()) {
+            return {};
+        }
+
+        if (auto out = rewrite_from(list, 2)) {
+            return Cell{std::move(*out)};
+        }
+
+        return {};
+    }
+
+    // Only a literal condition picks a branch. One that folds is
+    // still checked every time, which is cheap enough, and pruning
+    // under a guard would need the whole if kept around as well.
+    std::optional<Cell> Optimizer::rewrite_if(List const & list) {
+        if (list.size() < 3) {
+            return {};
+        }
+
+        auto out = rewrite_from(list, 1);
+        auto const & form = out ? *out : list;
+        if (auto const * cond = std::get_if<Bool>(&form[1])) {
+            if (cond->value()) {
+                return form[2];
+            }
+
+            return form.size() == 4 ? form[3] : Cell{Nil{}};
+        }
+
+        if (out) {
+            return Cell{std::move(*out)};
+        }
+
+        return {};
+    }
+
+    // A begin doesn't make a scope so its forms can go straight into
+    // the one around it. Literals that aren't the last form do nothing
+    // and go, and a begin with one form left is just that form.
+    std::optional<Cell> Optimizer::rewrite_begin(List const & list) {
+        auto out = rewrite_from(list, 1);
+        auto const & form = out ? *out : list;
+        auto const last = form.size() - 1;
+        auto work = form.size() == 2;
+        for (auto i = std::size_t{1}; i < form.size() && !work; ++i) {
+            work = (i != last && is_literal(form[i])) || splices(form[i], i == last);
+        }
+
+        if (!work) {
+            return out ? std::optional<Cell>{std::move(*out)} : std::nullopt;
+        }
+
+        List body{};
+        body.push_back(form.front());
+        auto add = [&body] (Cell const & cell, bool is_last) {
+            if (is_last || !is_literal(cell)) {
+                body.push_back(cell);
+            }
+        };
+
+        for (auto i = std::size_t{1}; i < form.size(); ++i) {
+            if (!splices(form[i], i == last)) {
+                add(form[i], i == last);
+                continue;
+            }
+
+            auto const & inner = std::get<List>(form[i]);
+            for (auto j = std::size_t{1}; j < inner.size(); ++j) {
+                add(inner[j], i == last && j == inner.size() - 1);
+            }
+        }
+
+        if (body.size() == 2) {
+            return std::move(body.back());
+        }
+
+        return Cell{std::move(body)};
+    }
+
+    std::optional<Cell> Optimizer::rewrite_lambda(List const & list) {
+        if (Function::malformed(list)) {
+            return {};
+        }
+
+        auto const mark = m_shadowed.size();
+        for (auto const & param : std::get<List>(list[1])) {
+            shadow(std::get<Symbol>(param));
+        }
+
+        for (auto i = std::size_t{2}; i < list.size(); ++i) {
+            find_defines(list[i]);
+        }
+
+        auto out = rewrite_from(list, 2);
+        m_shadowed.erase(m_shadowed.begin() + static_cast<std::ptrdiff_t>(mark), m_shadowed.end());
+        if (out) {
+            return Cell{std::move(*out)};
+        }
+
+        return {};
+    }
+
+    // The head gets rewritten too, it may well be a lambda
+    std::optional<Cell> Optimizer::rewrite_call(List const & list) {
+        auto out = rewrite_from(list, 0);
+        auto const & call = out ? *out : list;
+        if (auto value = fold(call)) {
+            return folded(std::move(*value), out ? Cell{std::move(*out)} : Cell{list});
+        }
+
+        if (out) {
+            return Cell{std::move(*out)};
+        }
+
+        return {};
+    }
+
+    // Whatever the native makes is gone again once we have it as a
+    // Cell. Only numbers and booleans come back out, anything else
+    // would be a new object every time it ran and eqv? could tell.
+    std::optional<Cell> Optimizer::fold(List const & call) {
+        auto const * head = std::get_if<Symbol>(&call.front());
+        if (!head || !is_pure(*head) || !builtins[builtin_index(head->id())].native) {
+            return {};
+        }
+
+        m_args.clear();
+        for (auto i = std::size_t{1}; i < call.size(); ++i) {
+            auto value = constant(call[i]);
+            if (!value) {
+                break;
+            }
+
+            m_args.push_back(*value);
+        }
+
+        auto result = std::optional<Cell>{};
+        if (m_args.size() == call.size() - 1) {
+            try {
+                auto value = builtins[builtin_index(head->id())].native(m_args, m_heap);
+                if (value.is_number() || value.is_fixnum() || value.is_bignum() || value.is_bool()) {
+                    result = value.to_cell();
+                }
+            }
+            catch (std::runtime_error const &) {
+                // It throws when it runs, that's when the error belongs
+            }
+        }
+
+        m_args.clear();
+        m_heap.clear();
+        return result;
+    }
+
+    bool Optimizer::is_pure(Symbol const & sym) const noexcept {
+        return is_builtin(sym) && builtins[builtin_index(sym.id())].pure
+            && std::find(m_shadowed.begin(), m_shadowed.end(), sym) == m_shadowed.end()
+            && m_env->builtin(sym);
+    }
+
+    std::optional<Value> Optimizer::constant(Cell const & cell) {
+        if (cell.is_number() || cell.is_bool()) {
+            return Value::from_cell(cell, m_heap);
+        }
+
+        if (auto const * sym = std::get_if<Symbol>(&cell)) {
+            if (is_pure(*sym) && !builtins[builtin_index(sym->id())].native) {
+                return *m_env->builtin(*sym);
+            }
+
+            return {};
+        }
+
+        if (is_form(cell, Symbol::Folded) && std::get<List>(cell).size() == 4) {
+            return Value::from_cell(std::get<List>(cell)[1], m_heap);
+        }
+
+        return {};
+    }
+
+    void Optimizer::find_defines(Cell const & cell) {
+        auto const * list = std::get_if<List>(&cell);
+        if (!list || is_form(cell, Symbol::Lambda)) {
+            return;
+        }
+
+        if (is_form(cell, Symbol::Define) && list->size() == 3 && list->at(1).is_symbol()) {
+            shadow(std::get<Symbol>(list->at(1)));
+        }
+
+        for (auto const & item : *list) {
+            find_defines(item);
+        }
+    }
+
+    // Only a builtin's name is ever asked about
+    void Optimizer::shadow(Symbol const & sym) {
+        if (is_builtin(sym)) {
+            m_shadowed.push_back(sym);
+        }
+    }
+}
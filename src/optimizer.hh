@@ -0,0 +1,86 @@
+#ifndef ESQUEMA_OPTIMIZER_HH_INCLUDED
+#define ESQUEMA_OPTIMIZER_HH_INCLUDED
+
+#include "ast.hh"
+#include "environ.hh"
+#include "heap.hh"
+#include "value.hh"
+#include <optional>
+#include <vector>
+
+namespace esquema {
+    // The Optimizer rewrites a parsed form before either engine gets
+    // to see it. Calls of the pure builtins whose arguments are all
+    // constants, and the pure constants themselves, are worked out
+    // right here. An if whose condition is a literal #t or #f loses
+    // the branch that can't run and nested begins are flattened into
+    // the one around them.
+    //
+    // Whatever is worked out ahead of time becomes
+    //
+    //     (#<folded> value original guard)
+    //
+    // since nothing stops anybody from defining pi or + later on,
+    // once the form has been folded, or in the very same program.
+    // The guard has a bit for every builtin the original uses, by
+    // its index in the table. Both engines check that none of those
+    // has been bound over before they take the value and go back to
+    // running the original if one has, see hidden. A name that a
+    // lambda binds, as a parameter or with a define in its body,
+    // isn't the builtin in there and is left well alone.
+    //
+    // Nothing that changes gets copied, a form with nothing to do
+    // comes back as nullopt and the pass doesn't allocate at all.
+    class Optimizer {
+    // Interface
+    public:
+        std::optional<Cell> optimize(Cell const & form, Environment const & env);
+        std::optional<List> optimize_all(List const & forms, Environment const & env);
+
+        // The builtins in original, a bit apiece
+        static std::uint64_t guard(Cell const & original) noexcept;
+
+        // The builtins env has bound over, a bit apiece. It only
+        // changes along with env's id, so it's worth keeping.
+        static std::uint64_t hidden(Environment const & env) noexcept;
+
+    // Helpers
+    private:
+        std::optional<Cell> rewrite(Cell const & cell);
+        std::optional<List> rewrite_from(List const & list, std::size_t first);
+        std::optional<Cell> rewrite_define(List const & list);
+        std::optional<Cell> rewrite_if(List const & list);
+        std::optional<Cell> rewrite_begin(List const & list);
+        std::optional<Cell> rewrite_lambda(List const & list);
+        std::optional<Cell> rewrite_call(List const & list);
+
+        // Works out a call whose arguments are constants if it's a
+        // pure builtin and doesn't throw, nullopt otherwise
+        std::optional<Cell> fold(List const & call);
+
+        // A pure builtin nothing around us has bound to anything else
+        bool is_pure(Symbol const & sym) const noexcept;
+
+        // The value of a literal, a folded form or a pure constant,
+        // nullopt if cell isn't any of those
+        std::optional<Value> constant(Cell const & cell);
+
+        // The names a lambda's body defines, not counting the
+        // ones in lambdas further in
+        void find_defines(Cell const & cell);
+        void shadow(Symbol const & sym);
+
+    // Data
+    private:
+        Environment const * m_env = nullptr;
+
+        // Bound by the lambdas we're in, innermost last
+        std::vector<Symbol> m_shadowed;
+
+        // Scratch space for the natives, cleared after each call
+        std::vector<Value> m_args;
+        Heap m_heap;
+    };
+}
+
+#endif
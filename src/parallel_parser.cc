@@ -0,0 +1,107 @@
+#include "parallel_parser.hh"
+#include "form_scanner.hh"
+#include <algorithm>
+#include <exception>
+#include <future>
+#include <iterator>
+
+namespace esquema {
+    List const & ParallelParser::parse_all(std::string_view src) {
+        auto chunks = split(src);
+        while (m_parsers.size() < chunks.size()) {
+            m_parsers.emplace_back();
+        }
+
+        auto parse_chunk = [this, &chunks] (std::size_t i) {
+            m_parsers[i].parse_all(chunks[i].txt, chunks[i].row, chunks[i].col);
+        };
+
+        // The last chunk is parsed on this thread while the pool
+        // does the rest. Everybody has to be done before anything
+        // is thrown, the parsers are about to be reused.
+        std::vector<std::future<void>> pending{};
+        pending.reserve(chunks.size());
+        for (auto i = std::size_t{0}; i + 1 < chunks.size(); ++i) {
+            pending.push_back(m_pool.submit([&parse_chunk, i] { parse_chunk(i); }));
+        }
+
+        std::exception_ptr last_error{};
+        try {
+            parse_chunk(chunks.size() - 1);
+        }
+        catch (...) {
+            last_error = std::current_exception();
+        }
+
+        for (auto & future : pending) {
+            future.wait();
+        }
+
+        for (auto & future : pending) {
+            future.get();
+        }
+
+        if (last_error) {
+            std::rethrow_exception(last_error);
+        }
+
+        // Moving a list keeps the memory it already has, so only
+        // the top level cells move and the forms stay put in the
+        // chunk parsers' arenas
+        auto total = std::size_t{0};
+        for (auto i = std::size_t{0}; i < chunks.size(); ++i) {
+            total += std::get<List>(*m_parsers[i].m_root).size();
+        }
+
+        m_arena.reset();
+        m_root = m_arena.make<Cell>();
+        auto forms = List(std::pmr::polymorphic_allocator<Cell>{&m_arena});
+        forms.reserve(total);
+        for (auto i = std::size_t{0}; i < chunks.size(); ++i) {
+            auto & part = std::get<List>(*m_parsers[i].m_root);
+            forms.insert(
+                forms.end(),
+                std::make_move_iterator(part.begin()),
+                std::make_move_iterator(part.end())
+            );
+        }
+
+        *m_root = std::move(forms);
+        return std::get<List>(*m_root);
+    }
+
+    std::size_t ParallelParser::threads() const noexcept {
+        return m_pool.size();
+    }
+
+    ParallelParser::ParallelParser(std::size_t threads, std::size_t min_chunk)
+        : m_pool{threads}, m_parsers{}, m_arena{}
+        , m_root{nullptr}, m_min_chunk{std::max<std::size_t>(min_chunk, 1)}
+    { }
+
+    // Cuts are made at the first place the scanner finds once
+    // a chunk is big enough, the tail goes in the last chunk
+    std::vector<ParallelParser::Chunk> ParallelParser::split(std::string_view src) const {
+        auto const target = std::max(m_min_chunk, src.size() / m_pool.size());
+        auto const * last = src.data() + src.size();
+        auto const * start = src.data();
+        auto start_row = 1, start_col = 1;
+        FormScanner scanner{start};
+        std::vector<Chunk> chunks{};
+        while (static_cast<std::size_t>(last - start) >= 2 * target) {
+            scanner.advance(start + target);
+            auto at = scanner.next_boundary(last);
+            if (!at) {
+                break;
+            }
+
+            chunks.push_back({std::string_view(start, at), start_row, start_col});
+            start = at;
+            start_row = scanner.row();
+            start_col = scanner.col();
+        }
+
+        chunks.push_back({std::string_view(start, last), start_row, start_col});
+        return chunks;
+    }
+}
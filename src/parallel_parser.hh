@@ -0,0 +1,61 @@
+#ifndef ESQUEMA_PARALLEL_PARSER_HH_INCLUDED
+#define ESQUEMA_PARALLEL_PARSER_HH_INCLUDED
+
+#include "arena.hh"
+#include "ast.hh"
+#include "parser.hh"
+#include "thread_pool.hh"
+#include <cstddef>
+#include <deque>
+#include <string_view>
+#include <vector>
+
+namespace esquema {
+    // Parses big sources with lots of top level forms on every core.
+    // A quick pre-scan with a FormScanner cuts the source where no
+    // form is open, each chunk gets its own Parser on the thread
+    // pool, and the forms are stitched back together in source
+    // order. Chunks know which row and column they start at so error
+    // messages read the same as the ones a single Parser would give,
+    // and when there are several errors it's the first one in the
+    // source that gets thrown.
+    //
+    // The forms stay in the chunk parsers' arenas, so just like
+    // Parser::parse_all the result is good until the next call.
+    class ParallelParser {
+    // Interface
+    public:
+        List const & parse_all(std::string_view src);
+        std::size_t threads() const noexcept;
+
+    // Constructors
+    public:
+        // Sources smaller than min_chunk per thread aren't worth
+        // splitting that finely, small ones aren't split at all
+        explicit ParallelParser(
+            std::size_t threads = 0,
+            std::size_t min_chunk = 1024 * 1024
+        );
+
+    // Helpers
+    private:
+        struct Chunk {
+            std::string_view txt;
+            int row, col;
+        };
+
+        std::vector<Chunk> split(std::string_view src) const;
+
+    // Data
+    private:
+        ThreadPool m_pool;
+
+        // A deque because parsers can't be moved
+        std::deque<Parser> m_parsers;
+        Arena m_arena;
+        Cell * m_root;
+        std::size_t m_min_chunk;
+    };
+}
+
+#endif
@@ -1,4 +1,7 @@
 #include "parser.hh"
+#include <algorithm>
+#include <charconv>
+#include <iterator>
 #include <stdexcept>
 #include <sstream>
 
@@ -8,16 +11,16 @@ namespace {
 }
 
 namespace esquema {
-    Cell Parser::parse(std::string_view src) {
-        m_lexer = Lexer{src};
+    Cell const & Parser::parse(std::string_view src) {
+        start(Lexer{src});
         // Just in case the string is empty. I take
         // care of this in main.cc
         if (src.empty()) {
-            return Nil{};
+            return *m_root;
         }
 
         auto cur = m_lexer.next();
-        auto result = parse_cell(cur);
+        *m_root = parse_cell(cur);
         if (cur != Token::Type::Eof) {
             std::ostringstream msg{};
             msg << "Malformed expression near "
@@ -26,50 +29,285 @@ namespace esquema {
             throw std::runtime_error{msg.str()};
         }
 
-        return result;
+        return *m_root;
     }
 
-    Cell Parser::parse_cell(Token & cur) {
-        if (cur == Token::Type::LPar) {
-            List list{};
-            cur = m_lexer.next();
-            while (cur != Token::Type::RPar) {
-                if (cur == Token::Type::Eof) {
-                    std::ostringstream msg{};
-                    msg << "Unexpected EOF near "sv
-                        << m_lexer.row() << '-' << m_lexer.col();
+    List const & Parser::parse_all(std::string_view src) {
+        return parse_all(src, 1, 1);
+    }
 
-                    throw std::runtime_error{msg.str()};
+    List const & Parser::parse_all(std::string_view src, int row, int col) {
+        start(Lexer{src, row, col});
+        auto cur = m_lexer.next();
+        while (cur != Token::Type::Eof) {
+            m_pending.push_back(parse_cell(cur));
+        }
+
+        *m_root = make_list(0);
+        return std::get<List>(*m_root);
+    }
+
+    List const & Parser::feed(std::string_view text) {
+        return feed(text, false);
+    }
+
+    List const & Parser::finish() {
+        return feed({}, true);
+    }
+
+    bool Parser::incomplete() const noexcept {
+        return !m_open.empty();
+    }
+
+    void Parser::discard() noexcept {
+        m_open.clear();
+        m_pending.clear();
+        m_carry.clear();
+        m_in_comment = false;
+    }
+
+    Parser::Parser(std::size_t max_nesting_bytes)
+        : m_lexer{}, m_arena{}, m_bignums{}, m_pending{}, m_open{}
+        , m_max_depth{std::max<std::size_t>(max_nesting_bytes / sizeof(std::size_t), 1)}
+        , m_root{nullptr}, m_forms{}, m_carry{}, m_joined{}
+        , m_row{1}, m_col{1}, m_in_comment{false}
+    { }
+
+    // Whatever a failed parse left behind has to go before
+    // the arena is reset underneath it
+    void Parser::start(Lexer lexer) {
+        discard();
+        m_arena.reset();
+        m_bignums.clear();
+        m_root = m_arena.make<Cell>();
+        m_lexer = lexer;
+    }
+
+    // Only the text up to the last delimiter gets lexed, whatever is
+    // after it could be the front half of a token and waits in
+    // m_carry for the rest. A comment that hasn't seen its newline
+    // yet is remembered with m_in_comment and the rest of it is
+    // skipped next time. None of the text is lexed twice, a token
+    // that straddles two feeds is the only thing that gets copied.
+    List const & Parser::feed(std::string_view text, bool last) {
+        try {
+            // The previous forms go, unless a list is still open
+            // because its children may be lists in the arena
+            if (m_open.empty()) {
+                m_arena.reset();
+                m_bignums.clear();
+            }
+
+            m_root = m_arena.make<Cell>();
+            m_forms.clear();
+            if (m_in_comment) {
+                auto eol = text.find('\n');
+                m_in_comment = eol == std::string_view::npos;
+                eol = std::min(eol, text.size());
+                m_col += static_cast<int>(eol);
+                text.remove_prefix(eol);
+            }
+
+            if (!m_carry.empty()) {
+                m_joined.assign(m_carry);
+                m_joined.append(text);
+                m_carry.clear();
+                text = m_joined;
+            }
+
+            auto ready = text;
+            auto comment = std::size_t{0};
+            if (!last) {
+                auto line = text.rfind('\n');
+                line = line == std::string_view::npos ? 0 : line + 1;
+                auto semi = text.find(';', line);
+                if (semi != std::string_view::npos) {
+                    comment = text.size() - semi;
+                    ready = text.substr(0, semi);
                 }
 
-                list.push_back(parse_cell(cur));
+                else {
+                    auto cut = text.find_last_of(" \t\n\v\f\r()"sv);
+                    cut = cut == std::string_view::npos ? 0 : cut + 1;
+                    ready = text.substr(0, cut);
+                    m_carry.assign(text.substr(cut));
+                }
             }
 
-            cur = m_lexer.next();
-            return std::move(list);
+            if (!ready.empty()) {
+                m_lexer = Lexer{ready, m_row, m_col};
+                auto cur = m_lexer.next();
+                while (cur != Token::Type::Eof) {
+                    Cell form{};
+                    if (!resume(cur, form)) {
+                        break;
+                    }
+
+                    m_forms.push_back(std::move(form));
+                }
+
+                m_row = m_lexer.row();
+                m_col = m_lexer.col();
+            }
+
+            if (comment != 0) {
+                m_in_comment = true;
+                m_col += static_cast<int>(comment);
+            }
+
+            if (last && !m_open.empty()) {
+                std::ostringstream msg{};
+                msg << "Unexpected EOF near "sv << m_row << '-' << m_col;
+                throw std::runtime_error{msg.str()};
+            }
+
+            auto forms = List(std::pmr::polymorphic_allocator<Cell>{&m_arena});
+            forms.reserve(m_forms.size());
+            forms.insert(
+                forms.end(),
+                std::make_move_iterator(m_forms.begin()),
+                std::make_move_iterator(m_forms.end())
+            );
+
+            m_forms.clear();
+            *m_root = std::move(forms);
+            return std::get<List>(*m_root);
+        }
+
+        // Half an expression isn't worth keeping after an error
+        catch (...) {
+            discard();
+            m_forms.clear();
+            throw;
         }
+    }
+
+    // Moves everything pending from mark on into a list. By now we
+    // know the size so the list is allocated once, in the arena.
+    List Parser::make_list(std::size_t mark) {
+        auto first = m_pending.begin() + mark;
+        auto list = List(std::pmr::polymorphic_allocator<Cell>{&m_arena});
+        list.reserve(m_pending.size() - mark);
+        list.insert(
+            list.end(),
+            std::make_move_iterator(first),
+            std::make_move_iterator(m_pending.end())
+        );
 
-        // Just in case we come across a wayward ')'
-        // the function above consumes any matched parens
-        else if (cur == Token::Type::RPar) {
+        m_pending.erase(first, m_pending.end());
+        return list;
+    }
+
+    Cell Parser::parse_cell(Token & cur) {
+        m_open.clear();
+        Cell form{};
+        if (!resume(cur, form)) {
             std::ostringstream msg{};
-            msg << "Unexpected ')' near "sv
+            msg << "Unexpected EOF near "sv
                 << m_lexer.row() << '-' << m_lexer.col();
 
             throw std::runtime_error{msg.str()};
         }
 
+        return form;
+    }
+
+    // No recursion, a '(' pushes where its children start in
+    // m_pending onto m_open and the matching ')' pops it and makes
+    // the list. How deep things can go is only up to m_max_depth.
+    // Whatever is open when the tokens run out stays open, so the
+    // next batch of tokens picks up right where this one left off.
+    bool Parser::resume(Token & cur, Cell & form) {
+        while (true) {
+            if (cur == Token::Type::LPar) {
+                if (m_open.size() == m_max_depth) {
+                    std::ostringstream msg{};
+                    msg << "Nesting deeper than "sv << m_max_depth
+                        << " levels near "sv << m_lexer.row() << '-'
+                        << m_lexer.col();
+
+                    throw std::runtime_error{msg.str()};
+                }
+
+                m_open.push_back(m_pending.size());
+                cur = m_lexer.next();
+                continue;
+            }
+
+            if (cur == Token::Type::RPar) {
+                // Just in case we come across a wayward ')'
+                if (m_open.empty()) {
+                    std::ostringstream msg{};
+                    msg << "Unexpected ')' near "sv
+                        << m_lexer.row() << '-' << m_lexer.col();
+
+                    throw std::runtime_error{msg.str()};
+                }
+
+                auto mark = m_open.back();
+                m_open.pop_back();
+                cur = m_lexer.next();
+                if (m_open.empty()) {
+                    form = make_list(mark);
+                    return true;
+                }
+
+                m_pending.emplace_back(make_list(mark));
+            }
+
+            else if (m_open.empty()) {
+                form = parse_atom(cur);
+                return true;
+            }
+
+            else if (cur == Token::Type::Eof) {
+                return false;
+            }
+
+            else {
+                m_pending.emplace_back(parse_atom(cur));
+            }
+        }
+    }
+
+    Cell Parser::parse_atom(Token & cur) {
         // Do the conversion here to take advantage
         // of row and column information
-        else if (cur == Token::Type::Num) {
-            auto value = 0.0D;
-            try {
-                value = std::stod(cur.str());
+        if (cur == Token::Type::Num) {
+            // Straight off the source text, no string, no locale and
+            // no exceptions. from_chars won't take a leading '+' so
+            // that is stepped over by hand.
+            auto txt = cur.strview();
+            auto first = txt.data();
+            auto last = txt.data() + txt.size();
+            if (first != last && *first == '+') {
+                ++first;
             }
 
-            catch (std::exception const & ex) {
+            // Nothing but digits is an exact integer, a BigInt if
+            // it won't fit in 64 bits
+            auto digits = first != last && *first == '-' ? first + 1 : first;
+            if (digits != last && std::all_of(digits, last, [] (char c) {
+                return c >= '0' && c <= '9';
+            })) {
+                auto exact = std::int64_t{0};
+                auto [ptr, ec] = std::from_chars(first, last, exact);
+                if (ec == std::errc{} && ptr == last) {
+                    cur = m_lexer.next();
+                    return Number::from_integer(exact);
+                }
+
+                auto big = *BigInt::from_string({first, last});
+                m_bignums.push_back(std::make_unique<BigInt const>(std::move(big)));
+                cur = m_lexer.next();
+                return Number::borrow_bigint(*m_bignums.back());
+            }
+
+            auto value = 0.0D;
+            auto [ptr, ec] = std::from_chars(first, last, value);
+            if (ec != std::errc{} || ptr != last) {
                 std::ostringstream msg{};
-                msg << "Invalid number '"sv << cur.strview()
+                msg << "Invalid number '"sv << txt
                     << "' near "sv << m_lexer.row() << '-'
                     << m_lexer.col();
 
@@ -1,23 +1,97 @@
 #ifndef ESQUEMA_PARSER_HH_INCLUDED
 #define ESQUEMA_PARSER_HH_INCLUDED
 
+#include "arena.hh"
 #include "lexer.hh"
 #include "ast.hh"
+#include "bigint.hh"
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
 
 namespace esquema {
     // A parser uses a lexer to produce an abstract syntax tree
-    // analysis of a program in a string. Since Lexers are cheap
-    // to copy so are parsers which allows you to do lookahead parsing
-    // fairly simply, and cheaply.
+    // analysis of a program in a string. The tree is built inside
+    // the parser's Arena, every list allocated once at its final
+    // size, and it stays valid until the next call to parse. At
+    // that point the whole thing is thrown away in one go, no
+    // destructors, no frees. If you want to keep a piece of a
+    // tree around copy it, copies go on the regular heap.
     class Parser {
     public:
-        Cell parse(std::string_view src);
+        Cell const & parse(std::string_view src);
 
+        // Parses every top level form in src, in order, with one
+        // Lexer and one pass. The forms live in the arena just like
+        // a single parse and are good until the next call.
+        List const & parse_all(std::string_view src);
+
+        // Same thing for a piece cut out of a bigger source, row and
+        // col are where it starts so errors point at the right place
+        List const & parse_all(std::string_view src, int row, int col);
+
+        // Incremental parsing for input that shows up a bit at a
+        // time, like a REPL or a pipe. Each call parses as much of the
+        // text as it can and returns the forms it finished, good until
+        // the next call. Open lists, a token cut off at the end of the
+        // text and the row and column carry over to the next call.
+        // finish() says there's no more text, anything still open is
+        // an error then. A parse error throws away the partial form,
+        // so does calling parse or parse_all in between.
+        List const & feed(std::string_view text);
+        List const & finish();
+
+        // True while a list is open and more text is needed
+        bool incomplete() const noexcept;
+
+        // Forgets the partial form, the row and column keep counting
+        void discard() noexcept;
+
+    public:
+        // Lists can nest as deep as max_nesting_bytes worth of
+        // bookkeeping allows, a machine word per level
+        explicit Parser(std::size_t max_nesting_bytes = default_max_nesting_bytes);
+
+    // The parallel parser moves the forms out of its chunk
+    // parsers when it stitches the chunks together
     private:
+        friend class ParallelParser;
+
+        void start(Lexer lexer);
+        List const & feed(std::string_view text, bool last);
         Cell parse_cell(Token & token);
+        bool resume(Token & token, Cell & form);
+        Cell parse_atom(Token & token);
+        List make_list(std::size_t mark);
 
     private:
         Lexer m_lexer;
+        Arena m_arena;
+
+        // Big literals in the arena's trees borrow from here, they
+        // go when the arena is reset
+        std::vector<std::unique_ptr<BigInt const>> m_bignums;
+
+        // Children of the lists that are still open wait here
+        // until we know how big their list has to be. It is kept
+        // between parses so it only grows a handful of times.
+        std::vector<Cell> m_pending;
+
+        // Where the children of each open list start in m_pending,
+        // the parser's stack really
+        std::vector<std::size_t> m_open;
+        std::size_t m_max_depth;
+        Cell * m_root;
+
+        // What feed needs to keep between calls
+        std::vector<Cell> m_forms;
+        std::string m_carry;
+        std::string m_joined;
+        int m_row, m_col;
+        bool m_in_comment;
+
+        static constexpr std::size_t default_max_nesting_bytes = 64 * 1024 * 1024;
     };
 }
 
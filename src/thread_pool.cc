@@ -0,0 +1,50 @@
+#include "thread_pool.hh"
+#include <algorithm>
+
+namespace esquema {
+    std::size_t ThreadPool::size() const noexcept {
+        return m_threads.size();
+    }
+
+    ThreadPool::ThreadPool(std::size_t threads)
+        : m_mutex{}, m_ready{}, m_tasks{}, m_threads{}
+    {
+        if (threads == 0) {
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+
+        m_threads.reserve(threads);
+        for (auto i = std::size_t{0}; i < threads; ++i) {
+            m_threads.emplace_back([this] (std::stop_token stop) { work(stop); });
+        }
+    }
+
+    // Asking them all to stop before joining any of them, otherwise
+    // each jthread's destructor would wait on a thread nobody woke
+    ThreadPool::~ThreadPool() {
+        for (auto & thread : m_threads) {
+            thread.request_stop();
+        }
+
+        m_threads.clear();
+    }
+
+    // Tasks still queued when we are asked to stop are dropped,
+    // their futures report a broken promise
+    void ThreadPool::work(std::stop_token stop) {
+        while (true) {
+            std::function<void()> task{};
+            {
+                std::unique_lock lock{m_mutex};
+                if (!m_ready.wait(lock, stop, [this] { return !m_tasks.empty(); })) {
+                    return;
+                }
+
+                task = std::move(m_tasks.front());
+                m_tasks.pop_front();
+            }
+
+            task();
+        }
+    }
+}
@@ -0,0 +1,62 @@
+#ifndef ESQUEMA_THREAD_POOL_HH_INCLUDED
+#define ESQUEMA_THREAD_POOL_HH_INCLUDED
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace esquema {
+    // A fixed number of threads pulling tasks off one queue. Nothing
+    // clever, the tasks we hand it are big enough that the lock on
+    // the queue never shows up. Whatever a task throws comes back
+    // out of its future.
+    class ThreadPool {
+    // Interface
+    public:
+        template <typename Fn>
+        std::future<std::invoke_result_t<Fn>> submit(Fn fn) {
+            using Result = std::invoke_result_t<Fn>;
+            auto task = std::make_shared<std::packaged_task<Result()>>(std::move(fn));
+            auto future = task->get_future();
+            {
+                std::lock_guard lock{m_mutex};
+                m_tasks.emplace_back([task] { (*task)(); });
+            }
+
+            m_ready.notify_one();
+            return future;
+        }
+
+        std::size_t size() const noexcept;
+
+    // Constructors
+    public:
+        // Zero threads means one per hardware thread
+        explicit ThreadPool(std::size_t threads = 0);
+        ThreadPool(ThreadPool const &) = delete;
+        ThreadPool & operator=(ThreadPool const &) = delete;
+        ~ThreadPool();
+
+    // Helpers
+    private:
+        void work(std::stop_token stop);
+
+    // Data
+    private:
+        std::mutex m_mutex;
+        std::condition_variable_any m_ready;
+        std::deque<std::function<void()>> m_tasks;
+
+        // Last so the threads are joined before the queue goes away
+        std::vector<std::jthread> m_threads;
+    };
+}
+
+#endif
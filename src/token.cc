@@ -34,15 +34,11 @@ namespace esquema {
         return m_txt;
     }
 
-    std::string const & Token::str() const noexcept {
-        return m_txt;
+    std::string Token::str() const {
+        return std::string{m_txt};
     }
 
     Token::Type Token::type() const noexcept {
         return m_type;
     }
-
-    Token::Token(Token::Type type, std::string_view txt) 
-        : m_txt{txt}, m_type{type}
-    { }
 }
@@ -4,11 +4,14 @@
 #include <cstdint>
 #include <iosfwd>
 #include <string>
+#include <string_view>
 
 namespace esquema {
     // A token designates the 'words' and 'punctuation' of a program
     // It will have a type and might have some text. Punctuation doesn't
-    // have the corresponding text because it is constant
+    // have the corresponding text because it is constant. The text is
+    // a view straight into the source the Lexer was given, nothing is
+    // copied, so that source has to outlive every Token scanned from it.
     class Token {
     public:
         enum class Type : std::uint8_t {
@@ -28,19 +31,24 @@ namespace esquema {
     // Interface
     public:
         std::string_view strview() const noexcept;
-        std::string const & str() const noexcept;
         Type type() const noexcept;
 
+        // This one makes a copy, don't use it in anything hot
+        std::string str() const;
+
     // Constructors
     public:
-        explicit Token(Type type, std::string_view txt = "");
+        constexpr explicit Token(Type type, std::string_view txt = {}) noexcept
+            : m_txt{txt}, m_type{type}
+        { }
+
         constexpr Token() noexcept
             : m_txt{}, m_type{Type::Err}
         { }
 
     // Details
     private:
-        std::string m_txt;
+        std::string_view m_txt;
         Type m_type;
     };
 }
@@ -0,0 +1,277 @@
+#include "value.hh"
+#include "bigint.hh"
+#include "closure.hh"
+#include "heap.hh"
+#include <bit>
+#include <cassert>
+#include <cmath>
+#include <ostream>
+
+namespace esquema {
+    // Printing goes through Cell so that both print the same
+    std::ostream & operator<<(std::ostream & ostr, Value const & value) {
+        return ostr << value.to_cell();
+    }
+
+    Value::Tag Value::tag() const noexcept {
+        if ((m_bits & box_mask) != box_mask) {
+            return Tag::Number;
+        }
+
+        return static_cast<Tag>((m_bits & tag_mask) >> tag_shift);
+    }
+
+    bool Value::is_number() const noexcept {
+        return (m_bits & box_mask) != box_mask;
+    }
+
+    bool Value::is_fixnum() const noexcept {
+        return tag() == Tag::Fixnum;
+    }
+
+    bool Value::is_nil() const noexcept {
+        return m_bits == boxed_nil;
+    }
+
+    bool Value::is_bool() const noexcept {
+        return tag() == Tag::Bool;
+    }
+
+    bool Value::is_symbol() const noexcept {
+        return tag() == Tag::Symbol;
+    }
+
+    bool Value::is_native() const noexcept {
+        return tag() == Tag::Native;
+    }
+
+    bool Value::is_closure() const noexcept {
+        return tag() == Tag::Closure;
+    }
+
+    bool Value::is_object() const noexcept {
+        return tag() == Tag::Object;
+    }
+
+    bool Value::is_empty_list() const noexcept {
+        return is_object() && payload() == 0;
+    }
+
+    bool Value::is_pair() const noexcept {
+        return is_object() && payload() != 0 && object()->kind() == Object::Kind::Pair;
+    }
+
+    bool Value::is_list() const noexcept {
+        return is_object() && (payload() == 0 || object()->kind() == Object::Kind::Pair);
+    }
+
+    bool Value::is_proc() const noexcept {
+        return is_object() && payload() != 0 && object()->kind() == Object::Kind::Proc;
+    }
+
+    bool Value::is_bignum() const noexcept {
+        return is_object() && payload() != 0 && object()->kind() == Object::Kind::BigInt;
+    }
+
+    double Value::number() const noexcept {
+        return std::bit_cast<double>(m_bits);
+    }
+
+    // Shifted up to the top and back down again to get the sign back
+    std::int64_t Value::fixnum() const noexcept {
+        return static_cast<std::int64_t>(payload() << (64 - tag_shift)) >> (64 - tag_shift);
+    }
+
+    bool Value::boolean() const noexcept {
+        return payload() != 0;
+    }
+
+    Symbol Value::symbol() const noexcept {
+        return Symbol::from_id(static_cast<std::uint32_t>(payload()));
+    }
+
+    Native Value::native() const noexcept {
+        return reinterpret_cast<Native>(static_cast<std::uintptr_t>(payload()));
+    }
+
+    Closure const * Value::closure() const noexcept {
+        return reinterpret_cast<Closure const *>(static_cast<std::uintptr_t>(payload()));
+    }
+
+    Object * Value::object() const noexcept {
+        return reinterpret_cast<Object *>(static_cast<std::uintptr_t>(payload()));
+    }
+
+    PairObject const * Value::pair() const noexcept {
+        return static_cast<PairObject const *>(object());
+    }
+
+    BigObject const * Value::bignum() const noexcept {
+        return static_cast<BigObject const *>(object());
+    }
+
+    Object const * Value::heap_object() const noexcept {
+        switch (tag()) {
+            case Tag::Closure:
+                return closure();
+            case Tag::Object:
+                return object();
+            default:
+                return nullptr;
+        }
+    }
+
+    std::uint64_t Value::bits() const noexcept {
+        return m_bits;
+    }
+
+    Cell Value::to_cell() const {
+        switch (tag()) {
+            case Tag::Number:
+                return Number{number()};
+            case Tag::Fixnum:
+                return Number::from_integer(fixnum());
+            case Tag::Nil:
+                return Nil{};
+            case Tag::Bool:
+                return Bool{boolean()};
+            case Tag::Symbol:
+                return symbol();
+            case Tag::Native:
+                return native();
+            case Tag::Closure:
+                closure()->pin();
+                return Lambda{closure(), [] (Closure const * closure) { closure->unpin(); }};
+            case Tag::Object:
+                break;
+        }
+
+        if (is_proc()) {
+            return static_cast<ProcObject const *>(object())->proc();
+        }
+
+        if (is_bignum()) {
+            return Number::from_bigint(bignum()->value());
+        }
+
+        // A loop, not recursion, lists can be long
+        List list{};
+        if (is_pair()) {
+            list.reserve(pair()->length());
+        }
+
+        for (auto rest = *this; rest.is_pair(); rest = rest.pair()->cdr()) {
+            list.push_back(rest.pair()->car().to_cell());
+        }
+
+        return list;
+    }
+
+    Value Value::from_cell(Cell const & cell, Heap & heap) {
+        if (auto ptr = std::get_if<Number>(&cell)) {
+            if (ptr->is_big()) {
+                return from_integer(ptr->big(), heap);
+            }
+            else if (auto exact = ptr->fixnum(); exact && !fits_fixnum(*exact)) {
+                return from_integer(BigInt{*exact}, heap);
+            }
+
+            return *ptr;
+        }
+        else if (auto ptr = std::get_if<Bool>(&cell)) {
+            return *ptr;
+        }
+        else if (auto ptr = std::get_if<Symbol>(&cell)) {
+            return *ptr;
+        }
+        else if (auto ptr = std::get_if<Native>(&cell)) {
+            return *ptr;
+        }
+        else if (auto ptr = std::get_if<Proc>(&cell)) {
+            return static_cast<Object *>(heap.make<ProcObject>(*ptr));
+        }
+        else if (auto ptr = std::get_if<Lambda>(&cell)) {
+            return ptr->get();
+        }
+        // Consed up from the back, the empty list costs nothing
+        else if (auto ptr = std::get_if<List>(&cell)) {
+            auto list = empty_list();
+            for (auto it = ptr->rbegin(); it != ptr->rend(); ++it) {
+                list = heap.make<PairObject>(from_cell(*it, heap), list);
+            }
+
+            return list;
+        }
+
+        return Nil{};
+    }
+
+    Value::Value(Nil) noexcept
+        : m_bits{boxed_nil}
+    { }
+
+    Value::Value(Bool value) noexcept
+        : m_bits{box(Tag::Bool, value.value() ? 1 : 0)}
+    { }
+
+    // NaNs all get folded into the one canonical NaN so that
+    // whatever payload they had can't be mistaken for a box. An
+    // exact integer too big to be a fixnum needs a Heap, without
+    // one it has to make do as a double, see from_cell.
+    Value::Value(Number value) noexcept
+        : m_bits{std::bit_cast<std::uint64_t>(value.value())}
+    {
+        if (auto exact = value.fixnum(); exact && fits_fixnum(*exact)) {
+            m_bits = box(Tag::Fixnum, static_cast<std::uint64_t>(*exact) & payload_mask);
+        }
+        else if (std::isnan(value.value())) {
+            m_bits = canonical_nan;
+        }
+    }
+
+    Value::Value(Symbol value) noexcept
+        : m_bits{box(Tag::Symbol, value.id())}
+    { }
+
+    Value::Value(Native value) noexcept
+        : m_bits{box(Tag::Native, reinterpret_cast<std::uintptr_t>(value))}
+    { }
+
+    Value::Value(Closure const * value) noexcept
+        : m_bits{box(Tag::Closure, reinterpret_cast<std::uintptr_t>(value))}
+    { }
+
+    Value::Value(Object * value) noexcept
+        : m_bits{box(Tag::Object, reinterpret_cast<std::uintptr_t>(value))}
+    { }
+
+    Value Value::empty_list() noexcept {
+        return static_cast<Object *>(nullptr);
+    }
+
+    Value Value::from_fixnum(std::int64_t value) noexcept {
+        assert(fits_fixnum(value) && "integer doesn't fit in a fixnum");
+        auto result = Value{};
+        result.m_bits = box(Tag::Fixnum, static_cast<std::uint64_t>(value) & payload_mask);
+        return result;
+    }
+
+    Value Value::from_integer(BigInt value, Heap & heap) {
+        if (value.fits_int64() && fits_fixnum(value.to_int64())) {
+            return from_fixnum(value.to_int64());
+        }
+
+        return static_cast<Object *>(heap.make<BigObject>(std::move(value)));
+    }
+
+    std::uint64_t Value::box(Tag tag, std::uint64_t payload) noexcept {
+        assert((payload & ~payload_mask) == 0 && "payload doesn't fit in a Value");
+        return box_mask
+            | (std::uint64_t{static_cast<std::uint8_t>(tag)} << tag_shift)
+            | payload;
+    }
+
+    std::uint64_t Value::payload() const noexcept {
+        return m_bits & payload_mask;
+    }
+}
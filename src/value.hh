@@ -0,0 +1,138 @@
+#ifndef ESQUEMA_VALUE_HH_INCLUDED
+#define ESQUEMA_VALUE_HH_INCLUDED
+
+#include "ast.hh"
+#include <cstdint>
+#include <iosfwd>
+
+namespace esquema {
+    class Heap;
+    class Object;
+    class PairObject;
+    class BigObject;
+
+    // A Value is the VM's version of a Cell squeezed into a single
+    // machine word. Doubles are stored as themselves. Everything
+    // else hides in the payload of a quiet NaN that arithmetic
+    // never produces: a 3 bit tag sits right under the NaN marker
+    // and the low 47 bits hold the payload, which is plenty for a
+    // symbol id, a user space pointer or a small exact integer, a
+    // fixnum, in two's complement. Anything too big to fit, like a
+    // list or a bignum, lives on a Heap and the Value points at it.
+    // So do pairs, procs with the old calling convention and
+    // closures, only Natives get a tag of their own. A Value
+    // doesn't keep what it points to alive, whoever holds it has
+    // to tell the collector. Converting to and from Cell is how the
+    // VM talks to the rest of the world.
+    class Value {
+    public:
+        enum class Tag : std::uint8_t {
+            Number, Nil, Bool, Symbol, Native, Closure, Object, Fixnum
+        };
+
+        // What fits in the 47 bits of payload
+        static constexpr std::int64_t min_fixnum = -(std::int64_t{1} << 46);
+        static constexpr std::int64_t max_fixnum = (std::int64_t{1} << 46) - 1;
+
+    // Friends
+    public:
+        friend std::ostream & operator<<(std::ostream & ostr, Value const & value);
+
+    // Interface
+    public:
+        Tag tag() const noexcept;
+
+        // A double, that is. Exact integers are fixnums.
+        bool is_number() const noexcept;
+        bool is_fixnum() const noexcept;
+        bool is_nil() const noexcept;
+        bool is_bool() const noexcept;
+        bool is_symbol() const noexcept;
+        bool is_native() const noexcept;
+        bool is_closure() const noexcept;
+        bool is_object() const noexcept;
+
+        // Lists are pairs, or the empty list which is the null
+        // Object. A proc with the old calling convention is an
+        // Object too, see ProcObject.
+        bool is_empty_list() const noexcept;
+        bool is_pair() const noexcept;
+        bool is_list() const noexcept;
+        bool is_proc() const noexcept;
+
+        // An exact integer too big to be a fixnum
+        bool is_bignum() const noexcept;
+
+        // These don't check the tag, ask first
+        double number() const noexcept;
+        std::int64_t fixnum() const noexcept;
+        bool boolean() const noexcept;
+        Symbol symbol() const noexcept;
+        Native native() const noexcept;
+        Closure const * closure() const noexcept;
+        Object * object() const noexcept;
+        PairObject const * pair() const noexcept;
+        BigObject const * bignum() const noexcept;
+
+        // The Object behind an Object or a Closure, nullptr for
+        // anything that doesn't live on a Heap
+        Object const * heap_object() const noexcept;
+
+        std::uint64_t bits() const noexcept;
+
+    // Conversion interface
+    public:
+        // A closure comes out as a Lambda that pins it for as long
+        // as the Lambda is around
+        Cell to_cell() const;
+
+        // Lists get copied onto the heap, a Lambda already is on one
+        static Value from_cell(Cell const & cell, Heap & heap);
+
+    // Constructors
+    public:
+        Value(Nil) noexcept;
+        Value(Bool value) noexcept;
+        Value(Number value) noexcept;
+        Value(Symbol value) noexcept;
+        Value(Native value) noexcept;
+        Value(Closure const * value) noexcept;
+        Value(Object * value) noexcept;
+        static Value empty_list() noexcept;
+
+        // value has to fit, see fits_fixnum
+        static Value from_fixnum(std::int64_t value) noexcept;
+
+        // A fixnum if it fits, otherwise it goes on the heap
+        static Value from_integer(BigInt value, Heap & heap);
+        static constexpr bool fits_fixnum(std::int64_t value) noexcept {
+            return value >= min_fixnum && value <= max_fixnum;
+        }
+        constexpr Value() noexcept
+            : m_bits{boxed_nil}
+        { }
+
+    // Details
+    private:
+        // Bits 62 to 50 set is a quiet NaN with one more bit that no
+        // hardware NaN has set, so real NaNs never look boxed
+        static constexpr std::uint64_t box_mask = 0x7ffc'0000'0000'0000;
+        static constexpr std::uint64_t canonical_nan = 0x7ff8'0000'0000'0000;
+        static constexpr int tag_shift = 47;
+        static constexpr std::uint64_t tag_mask = std::uint64_t{0x7} << tag_shift;
+        static constexpr std::uint64_t payload_mask = (std::uint64_t{1} << tag_shift) - 1;
+        static constexpr std::uint64_t boxed_nil =
+            box_mask | (std::uint64_t{static_cast<std::uint8_t>(Tag::Nil)} << tag_shift);
+
+        static std::uint64_t box(Tag tag, std::uint64_t payload) noexcept;
+        std::uint64_t payload() const noexcept;
+
+    // Data
+    private:
+        std::uint64_t m_bits;
+    };
+
+    static_assert(sizeof(Value) == 8, "Value must fit in a machine word");
+}
+
+#endif
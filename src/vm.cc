@@ -0,0 +1,453 @@
+#include "vm.hh"
+#include "native_proc.hh"
+#include "optimizer.hh"
+#include <algorithm>
+#include <span>
+#include <sstream>
+#include <stdexcept>
+
+// Computed goto is a GNU extension, define ESQUEMA_NO_COMPUTED_GOTO
+// to force the portable switch based loop
+#if (defined(__GNUC__) || defined(__clang__)) && !defined(ESQUEMA_NO_COMPUTED_GOTO)
+#define ESQUEMA_COMPUTED_GOTO 1
+#else
+#define ESQUEMA_COMPUTED_GOTO 0
+#endif
+
+#if ESQUEMA_COMPUTED_GOTO
+#define VM_CASE(name) name##_label
+#define VM_DISPATCH() do { instr = *regs.ip++; goto *labels[static_cast<std::size_t>(instr.op)]; } while (false)
+#else
+#define VM_CASE(name) case Op::name
+#define VM_DISPATCH() break
+#endif
+
+namespace esquema {
+    Cell VM::run(Code const & code, Environment & env) {
+        m_stack.clear();
+        m_frames.clear();
+        m_env = &env;
+        auto regs = Registers{&code, code.instrs(), &env, 0};
+        if (m_heap.wants_collection()) {
+            collect(regs);
+        }
+
+        auto const * first = regs.ip;
+        auto instr = Instr{};
+
+#if ESQUEMA_COMPUTED_GOTO
+        // This has to be kept in the same order as Op
+        static void * const labels[] = {
+            &&Const_label, &&Local_label, &&Global_label,
+            &&Define_label, &&Pop_label, &&Jump_label,
+            &&JumpIfFalse_label, &&MakeClosure_label, &&Call_label,
+            &&TailCall_label, &&Raise_label, &&Return_label,
+            &&Fold_label, &&Add_label, &&Sub_label,
+            &&Mul_label, &&Div_label, &&Less_label,
+            &&LessEqual_label, &&Greater_label, &&GreaterEqual_label
+        };
+
+        VM_DISPATCH();
+#else
+        while (true) {
+            instr = *regs.ip++;
+            switch (instr.op) {
+#endif
+        VM_CASE(Const): {
+            m_stack.push_back(load(*regs.code, instr.arg));
+            VM_DISPATCH();
+        }
+
+        VM_CASE(Local): {
+            auto value = m_stack[regs.base + instr.arg];
+            m_stack.push_back(value);
+            VM_DISPATCH();
+        }
+
+        VM_CASE(Global): {
+            m_stack.push_back(global(*regs.code, instr.arg, *regs.env));
+            VM_DISPATCH();
+        }
+
+        VM_CASE(Define): {
+            define(*regs.code, instr.arg, *regs.env);
+            VM_DISPATCH();
+        }
+
+        VM_CASE(Pop): {
+            m_stack.pop_back();
+            VM_DISPATCH();
+        }
+
+        VM_CASE(Jump): {
+            regs.ip = first + instr.arg;
+            VM_DISPATCH();
+        }
+
+        VM_CASE(JumpIfFalse): {
+            auto cond = m_stack.back();
+            if (!cond.is_bool()) {
+                throw std::runtime_error{"if condition must evaluate to boolean"};
+            }
+
+            if (!cond.boolean()) {
+                regs.ip = first + instr.arg;
+            }
+
+            m_stack.pop_back();
+            VM_DISPATCH();
+        }
+
+        VM_CASE(MakeClosure): {
+            make_closure(*regs.code, instr.arg, *regs.env);
+            VM_DISPATCH();
+        }
+
+        VM_CASE(Call): {
+            regs = call(instr.arg, false, regs);
+            first = regs.code->instrs();
+            VM_DISPATCH();
+        }
+
+        VM_CASE(TailCall): {
+            regs = call(instr.arg, true, regs);
+            first = regs.code->instrs();
+            VM_DISPATCH();
+        }
+
+        VM_CASE(Raise): {
+            throw std::runtime_error{regs.code->message(instr.arg)};
+        }
+
+        VM_CASE(Return): {
+            if (!m_frames.empty()) {
+                regs = leave(regs);
+                first = regs.code->instrs();
+                VM_DISPATCH();
+            }
+
+            auto result = m_stack.back();
+            m_stack.pop_back();
+            return result.to_cell();
+        }
+
+        VM_CASE(Fold): {
+            auto & fold = regs.code->fold(instr.arg);
+            if (holds(fold)) {
+                m_stack.push_back(load(*regs.code, fold.constant));
+                regs.ip = first + fold.end;
+            }
+
+            VM_DISPATCH();
+        }
+
+        VM_CASE(Add): {
+            if (!binary<add, fast::add>()) {
+                regs = call(2, instr.arg != 0, regs);
+                first = regs.code->instrs();
+            }
+
+            VM_DISPATCH();
+        }
+
+        VM_CASE(Sub): {
+            if (!binary<sub, fast::sub>()) {
+                regs = call(2, instr.arg != 0, regs);
+                first = regs.code->instrs();
+            }
+
+            VM_DISPATCH();
+        }
+
+        VM_CASE(Mul): {
+            if (!binary<mul, fast::mul>()) {
+                regs = call(2, instr.arg != 0, regs);
+                first = regs.code->instrs();
+            }
+
+            VM_DISPATCH();
+        }
+
+        VM_CASE(Div): {
+            if (!binary<div, fast::div>()) {
+                regs = call(2, instr.arg != 0, regs);
+                first = regs.code->instrs();
+            }
+
+            VM_DISPATCH();
+        }
+
+        VM_CASE(Less): {
+            if (!binary<less, fast::less>()) {
+                regs = call(2, instr.arg != 0, regs);
+                first = regs.code->instrs();
+            }
+
+            VM_DISPATCH();
+        }
+
+        VM_CASE(LessEqual): {
+            if (!binary<less_equal, fast::less_equal>()) {
+                regs = call(2, instr.arg != 0, regs);
+                first = regs.code->instrs();
+            }
+
+            VM_DISPATCH();
+        }
+
+        VM_CASE(Greater): {
+            if (!binary<greater, fast::greater>()) {
+                regs = call(2, instr.arg != 0, regs);
+                first = regs.code->instrs();
+            }
+
+            VM_DISPATCH();
+        }
+
+        VM_CASE(GreaterEqual): {
+            if (!binary<greater_equal, fast::greater_equal>()) {
+                regs = call(2, instr.arg != 0, regs);
+                first = regs.code->instrs();
+            }
+
+            VM_DISPATCH();
+        }
+
+#if !ESQUEMA_COMPUTED_GOTO
+            }
+        }
+#endif
+    }
+
+    // This is out of line on purpose. Jumping through a computed
+    // goto doesn't run destructors so no handler in the loop may
+    // have anything with one alive when it dispatches. A native
+    // gets its arguments right off the stack and is done by the
+    // time we return, regs go back untouched.
+    VM::Registers VM::call(std::uint32_t argc, bool tail, Registers regs) {
+        auto const args_first = m_stack.size() - argc;
+        auto callee = m_stack[args_first - 1];
+        if (callee.is_closure()) {
+            return enter(*callee.closure(), argc, tail, regs);
+        }
+
+        auto args = std::span<Value const>{m_stack.data() + args_first, argc};
+        auto result = Value{};
+        if (callee.is_native()) {
+            result = callee.native()(args, m_heap);
+        }
+
+        else if (callee.is_proc()) {
+            auto proc = static_cast<ProcObject const *>(callee.object())->proc();
+            result = call_proc(proc, args, regs.env, m_heap);
+        }
+
+        else {
+            throw std::runtime_error{"Not a procedure"};
+        }
+
+        m_stack.resize(args_first - 1);
+        m_stack.push_back(result);
+        return regs;
+    }
+
+    // The closure is on the stack so the collector can see it, and
+    // it's the one place where everything we hold is a root. In a tail
+    // call the callee and its arguments slide down over the running
+    // lambda's and its frame is reused, whatever Environment it had
+    // is left for the collector.
+    VM::Registers VM::enter(Closure const & closure, std::uint32_t argc, bool tail, Registers regs) {
+        auto const & function = closure.function();
+        function.check_arity(argc);
+        if (m_heap.wants_collection()) {
+            collect(regs);
+        }
+
+        auto base = m_stack.size() - argc;
+        auto * env = closure.env();
+        Environment * scope = nullptr;
+        if (function.needs_scope()) {
+            scope = m_heap.make<Environment>(closure.env());
+            for (auto i = std::size_t{0}; i < argc; ++i) {
+                scope->insert(function.params()[i], m_stack[base + i]);
+            }
+
+            env = scope;
+        }
+
+        if (tail && !m_frames.empty()) {
+            std::copy(m_stack.begin() + (base - 1), m_stack.end(), m_stack.begin() + (regs.base - 1));
+            m_stack.resize(regs.base + argc);
+            base = regs.base;
+            m_frames.back().scope = scope;
+        }
+
+        else {
+            m_frames.push_back(Frame{regs, scope});
+        }
+
+        auto const & code = function.code();
+        return Registers{&code, code.instrs(), env, base};
+    }
+
+    // The result takes the place of the callee on the stack
+    VM::Registers VM::leave(Registers regs) {
+        auto result = m_stack.back();
+        m_stack.resize(regs.base - 1);
+        m_stack.push_back(result);
+
+        auto caller = m_frames.back().caller;
+        m_frames.pop_back();
+        return caller;
+    }
+
+    void VM::make_closure(Code const & code, std::uint32_t idx, Environment & env) {
+        Closure const * closure = m_heap.make<Closure>(code.function(idx), &env);
+        m_stack.push_back(closure);
+    }
+
+    // A constant that lives on the Code's heap is copied onto ours,
+    // the Code may well be gone before whatever ends up holding it.
+    // The Code keeps the copy so it's only made once per Heap.
+    Value VM::load(Code const & code, std::uint32_t idx) {
+        return code.constant(idx, m_heap);
+    }
+
+    // Once a variable has been found its slot is cached in the Code
+    // and every lookup after that is a compare and a load. When it
+    // was found further out than env, in the global Environment from
+    // inside a lambda say, the scopes in between are new on every
+    // call. All that matters about them is that none of them binds
+    // the name, and that's a bit apiece to check. Hiding a builtin
+    // gives the Environment a new id, so that's taken care of too.
+    Value VM::global(Code const & code, std::uint32_t idx, Environment & env) {
+        auto & ref = code.global(idx);
+        if (ref.env_id == env.id()) {
+            return *ref.slot;
+        }
+
+        if (ref.depth) {
+            auto * scope = &env;
+            auto depth = ref.depth;
+            while (depth && scope && !scope->may_bind(ref.symbol)) {
+                scope = scope->outer();
+                --depth;
+            }
+
+            if (!depth && scope && scope->id() == ref.env_id) {
+                return *ref.slot;
+            }
+        }
+
+        return lookup(ref, env);
+    }
+
+    // The same search Environment::find makes, only it keeps track
+    // of where it found the name. Only global reads through a shared
+    // slot, see define.
+    Value VM::lookup(GlobalRef & ref, Environment & env) {
+        auto depth = std::uint32_t{0};
+        for (auto * scope = &env; scope; scope = scope->outer(), ++depth) {
+            auto * slot = scope->slot(ref.symbol);
+            auto shared = !slot;
+            if (shared) {
+                slot = const_cast<Value *>(scope->builtin(ref.symbol));
+            }
+
+            if (slot) {
+                ref.env_id = scope->id();
+                ref.slot = slot;
+                ref.depth = depth;
+                ref.shared = shared;
+                return *slot;
+            }
+        }
+
+        std::ostringstream msg{};
+        msg << "Dereferenced unbound variable '"
+            << ref.symbol << "'";
+
+        throw std::runtime_error{msg.str()};
+    }
+
+    void VM::define(Code const & code, std::uint32_t idx, Environment & env) {
+        auto & ref = code.global(idx);
+        if (ref.env_id == env.id() && !ref.shared) {
+            env.assign(*ref.slot, m_stack.back());
+        }
+
+        else {
+            env.insert(ref.symbol, m_stack.back());
+            ref.env_id = env.id();
+            ref.slot = env.slot(ref.symbol);
+            ref.depth = 0;
+            ref.shared = false;
+        }
+
+        m_stack.back() = Nil{};
+    }
+
+    // The builtins only ever live in the Environment run was given,
+    // so that's the one to ask whatever Environment we're running in
+    bool VM::holds(FoldRef & fold) const noexcept {
+        if (fold.env_id != m_env->id()) {
+            fold.env_id = m_env->id();
+            fold.holds = !(fold.guard & Optimizer::hidden(*m_env));
+        }
+
+        return fold.holds;
+    }
+
+    // Every Environment a frame runs in is either on the stack, as
+    // a closure's, or in the frame as its scope
+    void VM::collect(Registers const & regs) {
+        m_heap.collect([&] (Tracer & tracer) {
+            for (auto value : m_stack) {
+                tracer.mark(value);
+            }
+
+            for (auto const & frame : m_frames) {
+                tracer.mark(frame.scope);
+                tracer.mark(frame.caller.env);
+            }
+
+            tracer.mark(regs.env);
+            tracer.mark(m_env);
+        });
+    }
+
+    Heap & VM::heap() noexcept {
+        return m_heap;
+    }
+
+    Heap const & VM::heap() const noexcept {
+        return m_heap;
+    }
+
+    VM::VM()
+        : m_stack{}, m_frames{}, m_heap{}, m_env{nullptr}
+    {
+        m_stack.reserve(256);
+    }
+
+    // The callee is still on the stack under its arguments, the way
+    // Call would find it. It's compared with the builtin itself so a
+    // redefined + or a parameter that's called + just gets called.
+    template <Native builtin, std::optional<Value> (*fast)(Value, Value) noexcept>
+    bool VM::binary() noexcept {
+        auto const size = m_stack.size();
+        auto const callee = m_stack[size - 3];
+        if (!callee.is_native() || callee.native() != builtin) {
+            return false;
+        }
+
+        auto const result = fast(m_stack[size - 2], m_stack[size - 1]);
+        if (!result) {
+            return false;
+        }
+
+        m_stack[size - 3] = *result;
+        m_stack.resize(size - 2);
+        return true;
+    }
+}
@@ -0,0 +1,88 @@
+#ifndef ESQUEMA_VM_HH_INCLUDED
+#define ESQUEMA_VM_HH_INCLUDED
+
+#include "closure.hh"
+#include "compiler.hh"
+#include "environ.hh"
+#include "heap.hh"
+#include "value.hh"
+#include <cstddef>
+#include <optional>
+#include <vector>
+
+namespace esquema {
+    // The VM runs the Code the Compiler produces. It is a stack
+    // machine with a single dispatch loop. When the compiler knows
+    // about computed goto (GCC and Clang do) each instruction jumps
+    // straight to the next handler, everybody else gets a switch.
+    // The value stack is kept between runs so that we don't pay
+    // for growing it on every evaluation. Everything on it is a
+    // Value, Cells only show up in what run hands back. Objects
+    // live on the VM's heap for as long as something can reach them,
+    // the stack, the frames and the Environment we're running against
+    // are the roots. It collects on the way into a lambda, at that
+    // point everything the loop holds on to is in one of those.
+    //
+    // Calling a lambda doesn't recurse in C++, the caller's place
+    // is pushed on a stack of frames and the loop carries on in the
+    // lambda's Code. Its arguments stay where they are on the value
+    // stack, that's where Local finds them. A TailCall reuses the
+    // running lambda's frame, so a loop written as a tail call runs
+    // in constant space however many times it goes around.
+    class VM {
+    // Interface
+    public:
+        Cell run(Code const & code, Environment & env);
+        Heap & heap() noexcept;
+        Heap const & heap() const noexcept;
+
+    // Constructors
+    public:
+        VM();
+
+    // Helpers
+    private:
+        // What the dispatch loop is working with, base is where
+        // the running lambda's arguments start on the stack
+        struct Registers {
+            Code const * code;
+            Instr const * ip;
+            Environment * env;
+            std::size_t base;
+        };
+
+        // The caller's registers and, when the lambda's parameters
+        // live in an Environment, the Environment
+        struct Frame {
+            Registers caller;
+            Environment * scope;
+        };
+
+        Registers call(std::uint32_t argc, bool tail, Registers regs);
+        Registers enter(Closure const & closure, std::uint32_t argc, bool tail, Registers regs);
+        Registers leave(Registers regs);
+        void make_closure(Code const & code, std::uint32_t idx, Environment & env);
+        Value load(Code const & code, std::uint32_t idx);
+        Value global(Code const & code, std::uint32_t idx, Environment & env);
+        Value lookup(GlobalRef & ref, Environment & env);
+        void define(Code const & code, std::uint32_t idx, Environment & env);
+        bool holds(FoldRef & fold) const noexcept;
+
+        // Does what Call 2 would if the callee is builtin and fast
+        // takes the arguments, false and the stack as it was if not
+        template <Native builtin, std::optional<Value> (*fast)(Value, Value) noexcept>
+        bool binary() noexcept;
+        void collect(Registers const & regs);
+
+    // Data
+    private:
+        std::vector<Value> m_stack;
+        std::vector<Frame> m_frames;
+        Heap m_heap;
+
+        // What run was called with, it's a root
+        Environment * m_env;
+    };
+}
+
+#endif
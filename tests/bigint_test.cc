@@ -0,0 +1,136 @@
+#include "bigint.hh"
+#include "gtest/gtest.h"
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace {
+    using namespace std::literals::string_view_literals;
+    using namespace std::literals::string_literals;
+    using namespace esquema;
+
+    // Always the same numbers so a failure can be chased down
+    std::vector<std::int64_t> chunks(std::size_t count, std::uint64_t seed) {
+        std::vector<std::int64_t> result{};
+        for (auto i = std::size_t{0}; i < count; ++i) {
+            seed = seed * 6364136223846793005u + 1442695040888963407u;
+            result.push_back(static_cast<std::int64_t>(seed >> 32));
+        }
+
+        return result;
+    }
+
+    // sum chunks[i] * 2^32i, built with nothing but small multiplications
+    BigInt from_chunks(std::vector<std::int64_t> const & parts) {
+        auto const base = BigInt{std::int64_t{1} << 32};
+        BigInt result{};
+        for (auto it = parts.rbegin(); it != parts.rend(); ++it) {
+            result = result * base + BigInt{*it};
+        }
+
+        return result;
+    }
+}
+
+TEST(BigIntTest, StringRoundTripTest) {
+    for (auto const & txt : {"0"s, "1"s, "-1"s, "18446744073709551616"s,
+                             "-340282366920938463463374607431768211457"s,
+                             "10000000000000000000000000000000000000000000000000000000000"s}) {
+        auto num = BigInt::from_string(txt);
+        ASSERT_TRUE(num.has_value());
+        ASSERT_EQ(num->to_string(), txt)
+            << "BigInt failed to round trip "sv << txt;
+    }
+
+    ASSERT_EQ(BigInt::from_string("+007")->to_string(), "7"s);
+    ASSERT_EQ(BigInt::from_string("-0")->to_string(), "0"s)
+        << "There is no negative zero"sv;
+    ASSERT_FALSE(BigInt::from_string("12a").has_value());
+    ASSERT_FALSE(BigInt::from_string("-").has_value());
+}
+
+TEST(BigIntTest, Int64Test) {
+    auto const min = std::numeric_limits<std::int64_t>::min();
+    auto const max = std::numeric_limits<std::int64_t>::max();
+    for (auto value : {std::int64_t{0}, std::int64_t{-5}, min, max}) {
+        auto num = BigInt{value};
+        ASSERT_TRUE(num.fits_int64());
+        ASSERT_EQ(num.to_int64(), value);
+        ASSERT_EQ(num.to_string(), std::to_string(value));
+    }
+
+    ASSERT_FALSE((BigInt{max} + BigInt{1}).fits_int64());
+    ASSERT_FALSE((BigInt{min} - BigInt{1}).fits_int64());
+    ASSERT_EQ((BigInt{min} - BigInt{1}).to_string(), "-9223372036854775809"s);
+}
+
+TEST(BigIntTest, ArithmeticTest) {
+    auto const big = *BigInt::from_string("18446744073709551615");
+    ASSERT_EQ((big + BigInt{1}).to_string(), "18446744073709551616"s)
+        << "Addition must carry into a new limb"sv;
+    ASSERT_EQ((big + BigInt{1} - BigInt{1}), big)
+        << "Subtraction must borrow out of the top limb"sv;
+    ASSERT_EQ((BigInt{3} - big).to_string(), "-18446744073709551612"s);
+    ASSERT_TRUE((big - big).is_zero());
+    ASSERT_FALSE((big - big).is_negative());
+    ASSERT_EQ((big * -big).to_string(), "-340282366920938463426481119284349108225"s);
+    ASSERT_TRUE((-big * BigInt{0}).is_zero());
+
+    ASSERT_LT(-big, BigInt{0});
+    ASSERT_LT(BigInt{0}, big);
+    ASSERT_LT(-big, -BigInt{5});
+    ASSERT_GT(big + BigInt{1}, big);
+}
+
+// Sizes on either side of the Karatsuba threshold, balanced and not,
+// checked against the same product done 32 bits at a time
+TEST(BigIntTest, MultiplicationTest) {
+    auto const base = BigInt{std::int64_t{1} << 32};
+    auto const sizes = std::vector<std::pair<std::size_t, std::size_t>>{
+        {10, 10}, {63, 64}, {64, 64}, {65, 66}, {130, 128}, {300, 250},
+        {400, 70}, {1000, 64}, {777, 555}
+    };
+
+    for (auto const & [lhs_size, rhs_size] : sizes) {
+        auto lhs = from_chunks(chunks(lhs_size, lhs_size));
+        auto rhs_parts = chunks(rhs_size, rhs_size + 17);
+        auto rhs = from_chunks(rhs_parts);
+
+        BigInt expected{};
+        for (auto it = rhs_parts.rbegin(); it != rhs_parts.rend(); ++it) {
+            expected = expected * base + lhs * BigInt{*it};
+        }
+
+        ASSERT_EQ(lhs * rhs, expected)
+            << "Wrong product for "sv << lhs_size << " by "sv << rhs_size << " half limbs"sv;
+        ASSERT_EQ(rhs * -lhs, -expected);
+    }
+
+    // (x + 1)(x - 1) = x^2 - 1, big enough to recurse a few times
+    auto x = from_chunks(chunks(2000, 7));
+    ASSERT_EQ((x + BigInt{1}) * (x - BigInt{1}), x * x - BigInt{1});
+}
+
+TEST(BigIntTest, ToDoubleTest) {
+    ASSERT_EQ(BigInt{}.to_double(), 0.0);
+    ASSERT_EQ(BigInt::from_string("18446744073709551616")->to_double(), 0x1p64);
+    ASSERT_EQ(BigInt::from_string("-36893488147419103232")->to_double(), -0x1p65);
+
+    // 2^64 + 2^11 + 1 is just past halfway between two doubles,
+    // the bits in the lower limb have to tip it up
+    ASSERT_EQ(BigInt::from_string("18446744073709553665")->to_double(), 0x1p64 + 0x1p12);
+    ASSERT_EQ(BigInt::from_string("18446744073709553664")->to_double(), 0x1p64)
+        << "Ties go to even"sv;
+
+    auto huge = BigInt{1};
+    for (auto i = 0; i < 20; ++i) {
+        huge = huge * BigInt{std::numeric_limits<std::int64_t>::max()};
+    }
+    ASSERT_EQ(huge.to_double(), std::numeric_limits<double>::infinity());
+}
+
+int main(int argc, char ** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
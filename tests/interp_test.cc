@@ -1,6 +1,18 @@
 #include "interp.hh"
+#include "bigint.hh"
+#include "heap.hh"
+#include "native_proc.hh"
+#include "optimizer.hh"
+#include "value.hh"
 #include "gtest/gtest.h"
 #include <algorithm>
+#include <cmath>
+#include <limits>
+#include <memory_resource>
+#include <numbers>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
 #include <string>
 #include <tuple>
 #include <vector>
@@ -10,6 +22,41 @@ namespace {
     using namespace std::literals::string_view_literals;
     using namespace std::literals::string_literals;
     using namespace esquema;
+
+    // Lists that aren't the parser's get their memory from the default
+    // resource, this one counts what it's asked for and hands it on.
+    // It's around for good, a list can outlive the count it was made in.
+    class CountingResource : public std::pmr::memory_resource {
+    public:
+        std::size_t allocations = 0;
+
+    private:
+        void * do_allocate(std::size_t bytes, std::size_t align) override {
+            ++allocations;
+            return std::pmr::new_delete_resource()->allocate(bytes, align);
+        }
+
+        void do_deallocate(void * ptr, std::size_t bytes, std::size_t align) override {
+            std::pmr::new_delete_resource()->deallocate(ptr, bytes, align);
+        }
+
+        bool do_is_equal(std::pmr::memory_resource const & other) const noexcept override {
+            return this == &other;
+        }
+    };
+
+    CountingResource counting_resource{};
+
+    // The lists fn makes and the objects it puts on interp's Heap
+    template <typename Fn>
+    std::size_t count_allocations(Interpreter const & interp, Fn && fn) {
+        auto const made = interp.heap_stats().made;
+        counting_resource.allocations = 0;
+        auto * previous = std::pmr::set_default_resource(&counting_resource);
+        fn();
+        std::pmr::set_default_resource(previous);
+        return counting_resource.allocations + (interp.heap_stats().made - made);
+    }
 }
 
 TEST(InterpreterTest, DefaultEnvironmentConstructorTest) {
@@ -35,7 +82,7 @@ TEST(InterpreterTest, EnvironmentInsertFindTest) {
     ASSERT_TRUE(it->second.is_number())
         << "Environment retrieved the wrong element"sv;
 
-    ASSERT_EQ(std::get<Number>(it->second).value(), 3.14)
+    ASSERT_EQ(it->second.number(), 3.14)
         << "Environment retrieved the wrong element"sv;
 
     auto other_sym = Symbol{"foo"s};
@@ -56,7 +103,7 @@ TEST(InterpreterTest, ParentEnvironmentFindTest) {
     ASSERT_TRUE(it->second.is_number())
         << "Environment retrieved the wrong symbol"sv;
 
-    ASSERT_EQ(std::get<Number>(it->second).value(), 3.14)
+    ASSERT_EQ(it->second.number(), 3.14)
         << "Environment retrieved the wrong symbol"sv;
 
     auto other_sym = Symbol{"foo"s};
@@ -65,11 +112,50 @@ TEST(InterpreterTest, ParentEnvironmentFindTest) {
         << "Environment found a non-existent symbol"sv;
 }
 
+TEST(InterpreterTest, SymbolMapTest) {
+    SymbolMap<int> map{};
+    std::vector<int const *> addresses{};
+    for (auto i = 0; i < 5000; ++i) {
+        auto [it, inserted] = map.try_emplace(Symbol{"sym-map-"s + std::to_string(i)}, i);
+        ASSERT_TRUE(inserted);
+        addresses.push_back(&it->second);
+    }
+
+    ASSERT_FALSE(map.try_emplace(Symbol{"sym-map-42"s}, -1).second)
+        << "SymbolMap inserted a key twice"sv;
+
+    auto i = 0;
+    for (auto const & [key, value] : map) {
+        ASSERT_EQ(value, i)
+            << "SymbolMap must iterate in insertion order"sv;
+        ASSERT_EQ(&value, addresses[static_cast<std::size_t>(i)])
+            << "SymbolMap moved a value when it grew"sv;
+        ++i;
+    }
+
+    for (auto j = 0; j < 5000; j += 7) {
+        auto it = map.find(Symbol{"SYM-MAP-"s + std::to_string(j)});
+        ASSERT_NE(it, map.end())
+            << "SymbolMap lost a key"sv;
+        ASSERT_EQ(it->second, j);
+    }
+
+    ASSERT_EQ(map.find(Symbol{"sym-map-none"s}), map.end())
+        << "SymbolMap found a key that was never inserted"sv;
+
+    auto copy = map;
+    copy.insert_or_assign(Symbol{"sym-map-0"s}, 100);
+    ASSERT_EQ(copy.find(Symbol{"sym-map-0"s})->second, 100);
+    ASSERT_EQ(map.find(Symbol{"sym-map-0"s})->second, 0)
+        << "A copy of a SymbolMap shared its values"sv;
+}
+
 TEST(InterpreterTest, GlobalEnvironmentTest) {
     auto global_keys = std::vector{
        "+"s, "-"s, "*"s, "/"s, "<"s, "<="s, 
        ">"s, ">="s, "eqv?"s, "not"s, "pi"s, 
-       "e"s  
+       "e"s, "cons"s, "car"s, "cdr"s, "list"s,
+       "length"s
     };
 
     std::sort(global_keys.begin(), global_keys.end());
@@ -77,7 +163,7 @@ TEST(InterpreterTest, GlobalEnvironmentTest) {
     std::vector<std::string> test_keys{};
     test_keys.reserve(std::distance(global_env.begin(), global_env.end()));
     for (auto const & [k, v] : global_env) {
-        test_keys.push_back(k);
+        test_keys.emplace_back(k.value().begin(), k.value().end());
     }
 
     std::sort(test_keys.begin(), test_keys.end());
@@ -85,6 +171,42 @@ TEST(InterpreterTest, GlobalEnvironmentTest) {
         << "Environment is missing the default keys"sv;
 }
 
+TEST(InterpreterTest, SharedBuiltinsTest) {
+    // A builtin that's been bound over shows up once, as the new binding
+    auto env = Environment::make_global();
+    auto const pi = Symbol{"pi"};
+    env.insert(pi, Number{3.0});
+    auto pis = std::count_if(env.begin(), env.end(), [&pi] (auto const & entry) {
+        return entry.first == pi;
+    });
+    ASSERT_EQ(pis, 1);
+    ASSERT_EQ(env.find(pi)->second.number(), 3.0);
+    ASSERT_EQ(Environment{&env}.find(pi)->second.number(), 3.0);
+
+    for (auto engine : {Interpreter::Engine::Bytecode, Interpreter::Engine::TreeWalker}) {
+        Interpreter first{engine};
+        Interpreter second{engine};
+        auto code = first.compile("(+ 1 2)"s);
+        ASSERT_EQ(std::get<Number>(first.run(code)).value(), 3.0);
+
+        // Hiding a builtin only hides it in that interpreter
+        first.eval("(define + *)"s);
+        ASSERT_EQ(std::get<Number>(first.run(code)).value(), 2.0)
+            << "A cached builtin survived being redefined"sv;
+        ASSERT_EQ(std::get<Number>(first.eval("(+ 1 2)"s)).value(), 2.0);
+        ASSERT_EQ(std::get<Number>(second.eval("(+ 1 2)"s)).value(), 3.0)
+            << "Redefining a builtin leaked into another interpreter"sv;
+
+        // Defining over a builtin the same Code just read from
+        // must not write into the shared table
+        Interpreter third{engine};
+        third.eval_all("(define pi (* pi 2)) (define pi (* pi 2))"s);
+        ASSERT_DOUBLE_EQ(std::get<Number>(third.eval("pi"s)).value(), 4 * std::numbers::pi);
+        ASSERT_DOUBLE_EQ(std::get<Number>(second.eval("pi"s)).value(), std::numbers::pi)
+            << "A define wrote into the shared builtins"sv;
+    }
+}
+
 TEST(InterpreterTest, EmptyProgramTest) {
     auto src = ""s;
     Interpreter interp{};
@@ -128,6 +250,773 @@ TEST(InterpeterTest, AdditionTest) {
     }
 }
 
+TEST(InterpreterTest, CaseInsensitiveLookupTest) {
+    Interpreter interp{};
+    interp.eval("(define The-Answer 42)"s);
+    auto res = interp.eval("the-answer"s);
+    ASSERT_TRUE(res.is_number())
+        << "Symbols must be looked up without regard to case"sv;
+
+    res = interp.eval("(IF (EQV? #t #T) The-ANSWER 0)"s);
+    ASSERT_EQ(std::get<Number>(res).value(), 42)
+        << "Special forms must be recognized without regard to case"sv;
+}
+
+namespace {
+    // A proc with the old calling convention
+    Cell old_add(List const & args, Environment *) {
+        auto sum = 0.0;
+        for (auto const & arg : args) {
+            sum += std::get<Number>(arg).value();
+        }
+
+        return Number{sum};
+    }
+}
+
+TEST(InterpreterTest, OldProcShimTest) {
+    VM vm{};
+    auto env = Environment::make_global();
+    env.insert(Symbol{"old-add"}, Value::from_cell(Proc{old_add}, vm.heap()));
+
+    Parser parser{};
+    Compiler compiler{};
+    auto code = compiler.compile(parser.parse("(old-add 1 2 (old-add 3 4) (+ 1 1))"s));
+    ASSERT_EQ(std::get<Number>(vm.run(code, env)).value(), 12.0)
+        << "A Proc with the old calling convention must still be callable"sv;
+
+    code = compiler.compile(parser.parse("old-add"s));
+    ASSERT_TRUE(vm.run(code, env).is_proc())
+        << "A Proc must come out of the VM as a Proc"sv;
+}
+
+TEST(InterpreterTest, ValueRoundTripTest) {
+    static_assert(sizeof(Value) == 8);
+    Heap heap{};
+    auto cells = std::vector<Cell>{
+        Nil{}, Bool{true}, Bool{false}, Number{0.0}, Number{-0.0},
+        Number{42.5}, Number{-1e300}, Symbol{"foo"s}, Native{add}, Proc{old_add},
+        Number{std::numeric_limits<double>::infinity()},
+        List{}, List{Number{1}, List{Symbol{"bar"s}, Bool{false}}, Nil{}}
+    };
+
+    for (auto const & cell : cells) {
+        auto value = Value::from_cell(cell, heap);
+        std::ostringstream expected{}, actual{};
+        expected << cell;
+        actual << value.to_cell();
+        ASSERT_EQ(expected.str(), actual.str())
+            << "Value failed to round trip "sv << cell;
+    }
+
+    auto nan = Value{Number{std::nan("0x3ffff")}};
+    ASSERT_TRUE(nan.is_number())
+        << "A NaN with a payload must still be a number"sv;
+
+    ASSERT_TRUE(std::isnan(nan.number()))
+        << "A boxed NaN must stay a NaN"sv;
+
+    ASSERT_TRUE(std::signbit(Value{Number{-0.0}}.number()))
+        << "Negative zero must keep its sign"sv;
+
+    ASSERT_TRUE(Value{}.is_nil())
+        << "A default constructed Value is Nil"sv;
+
+    auto const big = Number::from_bigint(*BigInt::from_string("123456789012345678901234567890"s));
+    auto const unboxed = Value{big};
+    ASSERT_TRUE(unboxed.is_number() && unboxed.number() == big.value())
+        << "Without a Heap a BigInt has to make do as a double"sv;
+
+    auto boxed = Value::from_cell(big, heap);
+    std::ostringstream expected{}, actual{};
+    expected << big;
+    actual << boxed.to_cell();
+    ASSERT_EQ(expected.str(), actual.str())
+        << "Value failed to round trip "sv << big;
+
+    Environment env{};
+    env.insert(Symbol{"big"s}, big);
+    ASSERT_TRUE(env.find(Symbol{"big"s})->second.is_number())
+        << "Binding a BigInt without a Heap must not crash"sv;
+}
+
+TEST(InterpreterTest, EngineAgreementTest) {
+    auto programs = std::vector{
+        "42"s, "#f"s, "()"s, "pi"s, "(+ 1 2 3)"s, "(- 10 4)"s,
+        "(* 2 (/ 9 3))"s, "(< 1 2 3)"s, "(>= 1 2)"s, "(eqv? #t #t)"s,
+        "(not #f)"s, "(begin)"s, "(begin 1 2 3)"s, "(if #t 1 2)"s,
+        "(if #f 1 2)"s, "(if #f 1)"s, "(if (< 1 2) (+ 1 1) (define))"s,
+        "(begin (define x 10) (define y (* x x)) (+ x y))"s,
+        "((lambda (x y) (* x y)) 6 7)"s, "(lambda (x) x)"s,
+        "((lambda (+) (+ 2 3)) *)"s, "((lambda () (define z 4) (* z z)))"s,
+        "(((lambda (n) (lambda (x) (+ x n))) 5) 10)"s,
+        "(list 1 (list 2 3) ())"s, "(cons 1 (cdr (list 2 3)))"s,
+        "(car (list #t))"s, "(length (list 1 2 3))"s, "(eqv? () ())"s,
+        "(* 2 pi (/ 1 360))"s, "(begin 1 (begin (define w 2) #t) w)"s,
+        "((lambda (pi) (* 2 pi)) 3)"s
+    };
+
+    Interpreter bytecode{Interpreter::Engine::Bytecode};
+    Interpreter tree_walker{Interpreter::Engine::TreeWalker};
+    for (auto const & src : programs) {
+        std::ostringstream expected{}, actual{};
+        expected << tree_walker.eval(src);
+        actual << bytecode.eval(src);
+        ASSERT_EQ(expected.str(), actual.str())
+            << "Engines disagree on '"sv << src << "'"sv;
+    }
+}
+
+TEST(InterpreterTest, EngineErrorAgreementTest) {
+    auto programs = std::vector{
+        "undefined"s, "(define x)"s, "(define 1 2)"s, "(if #t)"s,
+        "(if 1 2 3)"s, "(1,2,3)"s, "(+ #t 1)"s, "(/ 1 0)"s,
+        "(lambda)"s, "(lambda x x)"s, "(lambda (x))"s, "(lambda (x 1) x)"s,
+        "(lambda (x x) x)"s, "((lambda (x) x))"s, "((lambda (x) x) 1 2)"s,
+        "((lambda (x) (if x 1 2)) 3)"s
+    };
+
+    Interpreter bytecode{Interpreter::Engine::Bytecode};
+    Interpreter tree_walker{Interpreter::Engine::TreeWalker};
+    for (auto const & src : programs) {
+        std::string expected{}, actual{};
+        try { tree_walker.eval(src); }
+        catch (std::runtime_error const & ex) { expected = ex.what(); }
+
+        try { bytecode.eval(src); }
+        catch (std::runtime_error const & ex) { actual = ex.what(); }
+
+        ASSERT_FALSE(expected.empty())
+            << "Tree walker failed to throw on '"sv << src << "'"sv;
+
+        ASSERT_EQ(expected, actual)
+            << "Engines report different errors for '"sv << src << "'"sv;
+    }
+}
+
+TEST(InterpreterTest, CompileOnceRunManyTest) {
+    Interpreter interp{};
+    interp.eval("(define x 1)"s);
+    auto code = interp.compile("(+ x 1)"s);
+    for (auto i = 0; i < 3; ++i) {
+        auto res = interp.run(code);
+        ASSERT_TRUE(res.is_number())
+            << "Compiled code failed to reduce to a number"sv;
+
+        ASSERT_EQ(std::get<Number>(res).value(), 2)
+            << "Compiled code produced the wrong result"sv;
+    }
+
+    // Code looks globals up when it runs, not when it compiles
+    interp.eval("(define x 41)"s);
+    auto res = interp.run(code);
+    ASSERT_EQ(std::get<Number>(res).value(), 42)
+        << "Compiled code didn't see the new binding of x"sv;
+}
+
+TEST(InterpreterTest, GlobalSlotCacheTest) {
+    Parser parser{};
+    Compiler compiler{};
+    auto code = compiler.compile(parser.parse("(begin (define y (+ x 1)) y)"s));
+
+    // The same Code against two environments, the cached
+    // slots of one must never leak into the other
+    auto first = Environment::make_global();
+    auto second = Environment::make_global();
+    first.insert(Symbol{"x"}, Number{1});
+    second.insert(Symbol{"x"}, Number{100});
+
+    VM vm{};
+    for (auto i = 0; i < 3; ++i) {
+        ASSERT_EQ(std::get<Number>(vm.run(code, first)).value(), 2)
+            << "Cached slot went to the wrong environment"sv;
+        ASSERT_EQ(std::get<Number>(vm.run(code, second)).value(), 101)
+            << "Cached slot went to the wrong environment"sv;
+    }
+
+    // Rebinding writes through the cached cell
+    first.insert(Symbol{"x"}, Number{41});
+    ASSERT_EQ(std::get<Number>(vm.run(code, first)).value(), 42)
+        << "Cached slot missed a rebinding"sv;
+
+    // A copy has cells of its own
+    auto copy = first;
+    copy.insert(Symbol{"x"}, Number{9});
+    ASSERT_EQ(std::get<Number>(vm.run(code, copy)).value(), 10);
+    ASSERT_EQ(std::get<Number>(vm.run(code, first)).value(), 42)
+        << "A copied environment shared cells with the original"sv;
+
+    // Unbound until it isn't
+    auto lonely = compiler.compile(parser.parse("z"s));
+    auto env = Environment::make_global();
+    ASSERT_THROW(vm.run(lonely, env), std::runtime_error);
+    env.insert(Symbol{"z"}, Bool{true});
+    ASSERT_TRUE(vm.run(lonely, env).is_bool());
+}
+
+TEST(InterpreterTest, ScopeCacheTest) {
+    auto env = Environment::make_global();
+    Environment scope{&env};
+    auto const x = Symbol{"x"};
+    ASSERT_TRUE(env.may_bind(x))
+        << "The global Environment may bind anything"sv;
+    ASSERT_FALSE(scope.may_bind(x))
+        << "An empty scope binds nothing"sv;
+    scope.insert(x, Number{1});
+    ASSERT_TRUE(scope.may_bind(x));
+    ASSERT_EQ(scope.outer(), &env);
+
+    auto print = [] (Cell const & cell) {
+        std::ostringstream ostr{};
+        ostr << cell;
+        return ostr.str();
+    };
+
+    for (auto engine : {Interpreter::Engine::Bytecode, Interpreter::Engine::TreeWalker}) {
+        Interpreter interp{engine};
+
+        // Both closures run the same Code, only one of their scopes
+        // binds x. Whichever runs first mustn't decide for the other.
+        interp.eval_all("(define x 100)"
+                        "(define make (lambda (c) (if c (define x 1) #f) (lambda () x)))"
+                        "(define a (make #t)) (define b (make #f))"s);
+        ASSERT_EQ(print(interp.eval("(b)"s)), "100"s);
+        ASSERT_EQ(print(interp.eval("(a)"s)), "1"s);
+        ASSERT_EQ(print(interp.eval("(b)"s)), "100"s);
+
+        // Globals seen from a new scope on every call, cached on
+        // the first and redefined after
+        interp.eval("(define twice (lambda (n) (define m (* 2 n)) (+ m 0)))"s);
+        ASSERT_EQ(print(interp.eval("(twice 3)"s)), "6"s);
+        ASSERT_EQ(print(interp.eval("(twice 3)"s)), "6"s);
+        interp.eval("(define + -)"s);
+        ASSERT_EQ(print(interp.eval("(twice 3)"s)), "-6"s)
+            << "A cached builtin must not outlive its redefinition"sv;
+
+        interp.eval("(define add (lambda (n) (lambda (y) (- y n))))"s);
+        interp.eval("(define add5 (add 5))"s);
+        ASSERT_EQ(print(interp.eval("(add5 1)"s)), "-6"s);
+        interp.eval("(define n 1000)"s);
+        ASSERT_EQ(print(interp.eval("(add5 1)"s)), "-6"s)
+            << "A global must not hide a closure's own binding"sv;
+        interp.eval("(define - *)"s);
+        ASSERT_EQ(print(interp.eval("(add5 1)"s)), "5"s);
+    }
+}
+
+TEST(InterpreterTest, EvalAllTest) {
+    auto src = "(define x 10)\n(define y (* x x))\n; the answer\n(+ x y)\n"s;
+    for (auto engine : {Interpreter::Engine::Bytecode, Interpreter::Engine::TreeWalker}) {
+        Interpreter interp{engine};
+        auto result = interp.eval_all(src);
+        ASSERT_TRUE(result.is_number())
+            << "eval_all must return the value of the last form"sv;
+        ASSERT_EQ(std::get<Number>(result).value(), 110.0)
+            << "eval_all must evaluate the forms in order"sv;
+
+        ASSERT_TRUE(interp.eval_all(""s).is_nil())
+            << "An empty program evaluates to nil"sv;
+
+        // Whatever ran before the failing form sticks
+        ASSERT_THROW(interp.eval_all("(define z 1) (z)"s), std::runtime_error);
+        ASSERT_TRUE(interp.eval("z"s).is_number())
+            << "Forms before a failing one must have taken effect"sv;
+    }
+}
+
+TEST(InterpreterTest, LambdaTest) {
+    for (auto engine : {Interpreter::Engine::Bytecode, Interpreter::Engine::TreeWalker}) {
+        Interpreter interp{engine};
+        auto result = interp.eval("(lambda (x) x)"s);
+        ASSERT_TRUE(result.is_lambda())
+            << "lambda must evaluate to a Lambda"sv;
+
+        // Each closure holds on to the environment it was made in
+        interp.eval_all(
+            "(define make-adder (lambda (n) (lambda (x) (+ x n))))"
+            "(define add5 (make-adder 5))"
+            "(define add7 (make-adder 7))"s
+        );
+
+        ASSERT_EQ(std::get<Number>(interp.eval("(add5 10)"s)).value(), 15.0);
+        ASSERT_EQ(std::get<Number>(interp.eval("(add7 10)"s)).value(), 17.0)
+            << "Closures made by the same lambda must not share parameters"sv;
+        ASSERT_THROW(interp.eval("n"s), std::runtime_error)
+            << "A parameter leaked into the global environment"sv;
+
+        // Defines in a body stay in the body
+        interp.eval("(define twice-plus-one (lambda (x) (define y (* x 2)) (+ y 1)))"s);
+        ASSERT_EQ(std::get<Number>(interp.eval("(twice-plus-one 3)"s)).value(), 7.0);
+        ASSERT_THROW(interp.eval("y"s), std::runtime_error)
+            << "A define in a lambda body leaked into the global environment"sv;
+
+        // A closure is eqv? to itself and to nothing else
+        ASSERT_TRUE(std::get<Bool>(interp.eval("(eqv? add5 add5)"s)).value());
+        ASSERT_FALSE(std::get<Bool>(interp.eval("(eqv? add5 add7)"s)).value());
+
+        // Globals are looked up when the body runs, not when it's made
+        interp.eval_all("(define scale (lambda (x) (* x factor))) (define factor 3)"s);
+        ASSERT_EQ(std::get<Number>(interp.eval("(scale 2)"s)).value(), 6.0);
+        interp.eval("(define factor 4)"s);
+        ASSERT_EQ(std::get<Number>(interp.eval("(scale 2)"s)).value(), 8.0)
+            << "A lambda body saw a stale global"sv;
+
+        ASSERT_THROW(interp.eval("(add5 1 2)"s), std::runtime_error)
+            << "Calling a lambda with the wrong number of arguments must throw"sv;
+    }
+}
+
+TEST(InterpreterTest, TailCallTest) {
+    // Deep enough that a C++ frame per iteration would blow the stack
+    auto loop = "(define loop (lambda (n acc) (if (< n 1) acc (loop (+ n -1) (+ acc 1)))))"s;
+    auto even = "(define even? (lambda (n) (if (< n 1) #t (begin (odd? (+ n -1))))))"s;
+    auto odd = "(define odd? (lambda (n) (if (< n 1) #f (even? (+ n -1)))))"s;
+    for (auto engine : {Interpreter::Engine::Bytecode, Interpreter::Engine::TreeWalker}) {
+        Interpreter interp{engine};
+        interp.eval_all(loop + even + odd);
+        ASSERT_EQ(std::get<Number>(interp.eval("(loop 500000 0)"s)).value(), 500000.0)
+            << "A self tail call must run in constant stack"sv;
+        ASSERT_TRUE(std::get<Bool>(interp.eval("(even? 500001)"s)).value() == false)
+            << "Mutual tail calls must run in constant stack"sv;
+    }
+
+    // The VM doesn't recurse in C++ for any call, tail or not
+    Interpreter interp{};
+    interp.eval("(define count (lambda (n) (if (< n 1) 0 (+ 1 (count (+ n -1))))))"s);
+    ASSERT_EQ(std::get<Number>(interp.eval("(count 200000)"s)).value(), 200000.0);
+}
+
+TEST(InterpreterTest, ListTest) {
+    auto print = [] (Cell const & cell) {
+        std::ostringstream ostr{};
+        ostr << cell;
+        return ostr.str();
+    };
+
+    auto build = "(define build (lambda (n acc) (if (< n 1) acc (build (+ n -1) (cons n acc)))))"s;
+    for (auto engine : {Interpreter::Engine::Bytecode, Interpreter::Engine::TreeWalker}) {
+        Interpreter interp{engine};
+        ASSERT_EQ(print(interp.eval("(list 1 2 3)"s)), "(1,2,3)"s);
+        ASSERT_EQ(print(interp.eval("(list)"s)), "()"s);
+        ASSERT_EQ(print(interp.eval("(cons 0 (list 1 2))"s)), "(0,1,2)"s);
+        ASSERT_EQ(print(interp.eval("(cdr (list 1))"s)), "()"s);
+        ASSERT_EQ(std::get<Number>(interp.eval("(car (cdr (list 1 2)))"s)).value(), 2.0);
+        ASSERT_EQ(std::get<Number>(interp.eval("(length ())"s)).value(), 0.0);
+
+        // Consing shares the tail, it doesn't copy it
+        interp.eval_all("(define xs (list 1 2)) (define ys (cons 0 xs))"s);
+        ASSERT_TRUE(std::get<Bool>(interp.eval("(eqv? (cdr ys) xs)"s)).value())
+            << "cons must share its tail"sv;
+        ASSERT_FALSE(std::get<Bool>(interp.eval("(eqv? (list 1) (list 1))"s)).value())
+            << "eqv? compares pairs by identity"sv;
+
+        ASSERT_THROW(interp.eval("(car ())"s), std::runtime_error);
+        ASSERT_THROW(interp.eval("(cdr 1)"s), std::runtime_error);
+        ASSERT_THROW(interp.eval("(cons 1 2)"s), std::runtime_error)
+            << "There are no dotted pairs"sv;
+        ASSERT_THROW(interp.eval("(length 5)"s), std::runtime_error);
+
+        // Long enough to go through a few collections on the way
+        interp.eval(build);
+        ASSERT_EQ(std::get<Number>(interp.eval("(length (build 100000 ()))"s)).value(), 100000.0);
+        ASSERT_EQ(std::get<Number>(interp.eval("(car (cdr (build 100000 ())))"s)).value(), 2.0);
+    }
+}
+
+TEST(InterpreterTest, FixnumTest) {
+    auto print = [] (Cell const & cell) {
+        std::ostringstream ostr{};
+        ostr << cell;
+        return ostr.str();
+    };
+
+    for (auto engine : {Interpreter::Engine::Bytecode, Interpreter::Engine::TreeWalker}) {
+        Interpreter interp{engine};
+        auto res = std::get<Number>(interp.eval("(* 1000003 1000033)"s));
+        ASSERT_TRUE(res.is_exact())
+            << "Integer arithmetic must stay exact"sv;
+        ASSERT_EQ(res.exact(), 1000036000099);
+        ASSERT_EQ(print(res), "1000036000099"s)
+            << "Exact integers print all their digits"sv;
+
+        ASSERT_TRUE(std::get<Number>(interp.eval("(+ 1 2 (- 3 0))"s)).is_exact());
+        ASSERT_EQ(std::get<Number>(interp.eval("(length (list 1 2))"s)).exact(), 2);
+
+        // Any double in there makes the result a double
+        res = std::get<Number>(interp.eval("(+ 1 2.5)"s));
+        ASSERT_FALSE(res.is_exact());
+        ASSERT_EQ(res.value(), 3.5);
+
+        // Overflowing a fixnum makes a bignum instead of wrapping
+        res = std::get<Number>(interp.eval("(* 4194304 4194304 4194304)"s));
+        ASSERT_TRUE(res.is_big())
+            << "An overflowing product must make a bignum"sv;
+        ASSERT_EQ(print(res), "73786976294838206464"s);
+        res = std::get<Number>(interp.eval("(+ 70368744177663 1)"s));
+        ASSERT_TRUE(res.is_exact());
+        ASSERT_EQ(res.exact(), 70368744177664);
+
+        ASSERT_TRUE(std::get<Bool>(interp.eval("(< 1 1.5 2)"s)).value());
+        ASSERT_TRUE(std::get<Bool>(interp.eval("(<= 2 2.0 2)"s)).value());
+        ASSERT_FALSE(std::get<Bool>(interp.eval("(> -70368744177664 70368744177663)"s)).value());
+    }
+}
+
+TEST(InterpreterTest, BignumTest) {
+    auto print = [] (Cell const & cell) {
+        std::ostringstream ostr{};
+        ostr << cell;
+        return ostr.str();
+    };
+
+    auto fact = "(define fact (lambda (n acc) (if (< n 2) acc (fact (+ n -1) (* n acc)))))"s;
+    auto hundred = "93326215443944152681699238856266700490715968264381621468592963895217599993229915608941463976156518286253697920827223758251185210916864000000000000000000000000"s;
+    for (auto engine : {Interpreter::Engine::Bytecode, Interpreter::Engine::TreeWalker}) {
+        Interpreter interp{engine};
+        interp.eval(fact);
+        ASSERT_EQ(print(interp.eval("(fact 100 1)"s)), hundred)
+            << "Factorials must be exact"sv;
+
+        // Big literals, and bignums that shrink back down to fixnums
+        ASSERT_EQ(print(interp.eval("(* 100000000000000000000 -3)"s)), "-300000000000000000000"s);
+        auto res = std::get<Number>(interp.eval("(+ 100000000000000000000 -99999999999999999999)"s));
+        ASSERT_TRUE(res.is_exact() && !res.is_big());
+        ASSERT_EQ(res.exact(), 1);
+
+        ASSERT_TRUE(std::get<Bool>(interp.eval("(< 1 100000000000000000000 100000000000000000001)"s)).value());
+        ASSERT_FALSE(std::get<Bool>(interp.eval("(< 1000000000000000000000000000000.0 100000000000000000000)"s)).value());
+        ASSERT_TRUE(std::get<Bool>(interp.eval("(eqv? 100000000000000000000 100000000000000000000)"s)).value())
+            << "eqv? compares exact numbers by value"sv;
+        ASSERT_FALSE(std::get<Bool>(interp.eval("(eqv? 2 2.0)"s)).value())
+            << "An exact number is never eqv? to an inexact one"sv;
+        ASSERT_FALSE(std::get<Number>(interp.eval("(+ 100000000000000000000 0.5)"s)).is_exact());
+
+        // A big literal in a lambda has to outlive the parse it came from
+        interp.eval("(define big-literal (lambda () 123456789012345678901234567890))"s);
+        interp.eval("(+ 1 2)"s);
+        ASSERT_EQ(print(interp.eval("(big-literal)"s)), "123456789012345678901234567890"s);
+
+        // Enough garbage to go through a few collections, the
+        // bignums still in use have to come through them
+        interp.eval("(define big (fact 1000 1))"s);
+        for (auto i = 0; i < 5; ++i) {
+            interp.eval("(fact 1000 1)"s);
+        }
+        ASSERT_EQ(print(interp.eval("big"s)).size(), 2568u);
+        ASSERT_GT(interp.heap_stats().collections, 0u);
+    }
+
+    // A big literal is copied onto the VM's heap once, not every time it runs
+    Interpreter vm{Interpreter::Engine::Bytecode};
+    vm.eval("(define big-literal (lambda () 123456789012345678901234567890))"s);
+    ASSERT_EQ(print(vm.eval("(big-literal)"s)), "123456789012345678901234567890"s);
+    auto const made = vm.heap_stats().made;
+    for (auto i = 0; i < 5; ++i) {
+        vm.eval("(big-literal)"s);
+    }
+    ASSERT_EQ(vm.heap_stats().made, made)
+        << "Running a constant must not make it again"sv;
+
+    // The tree walker boxes one once per evaluation, every call
+    // after that only makes its scope
+    Interpreter walker{Interpreter::Engine::TreeWalker};
+    walker.eval("(define loop (lambda (n) (if (< n 1) n (loop (+ n -1 (* n 0 123456789012345678901234567890))))))"s);
+    auto made_by = [&walker] (std::string const & src) {
+        auto const made = walker.heap_stats().made;
+        walker.eval(src);
+        return walker.heap_stats().made - made;
+    };
+    ASSERT_EQ(made_by("(loop 20)"s) - made_by("(loop 10)"s), 10u)
+        << "Evaluating a big literal must not make it again"sv;
+}
+
+TEST(InterpreterTest, ConstantFoldingTest) {
+    auto print = [] (Cell const & cell) {
+        std::ostringstream ostr{};
+        ostr << cell;
+        return ostr.str();
+    };
+
+    Parser parser{};
+    Optimizer optimizer{};
+    auto env = Environment::make_global();
+    auto optimize = [&] (std::string const & src) {
+        return optimizer.optimize(parser.parse(src), env);
+    };
+
+    // The whole thing is worked out ahead of time, the
+    // original sticks around behind the guard
+    auto turn = optimize("(* 2 pi (/ 1 360))"s);
+    ASSERT_TRUE(turn && turn->is_list());
+    auto const & folded = std::get<List>(*turn);
+    ASSERT_EQ(folded.size(), 4u);
+    ASSERT_EQ(std::get<Symbol>(folded[0]).id(), Symbol::Folded);
+    ASSERT_DOUBLE_EQ(std::get<Number>(folded[1]).value(), std::numbers::pi / 180);
+    ASSERT_EQ(Optimizer::guard(folded[2]) & Optimizer::hidden(env), 0u);
+    auto const guard = static_cast<std::uint64_t>(std::get<Number>(folded[3]).exact());
+    ASSERT_EQ(guard, Optimizer::guard(folded[2]));
+    ASSERT_EQ(Optimizer::hidden(env), 0u);
+
+    // Pruning and flattening
+    ASSERT_EQ(print(*optimize("(if #t 1 (undefined))"s)), "1"s);
+    ASSERT_TRUE(optimize("(if #f 1)"s)->is_nil());
+    ASSERT_EQ(print(*optimize("(begin 1 (begin (define x 2) #t) (begin x))"s)), "(begin,(define,x,2),x)"s);
+
+    // Nothing to do and nothing gets made
+    ASSERT_FALSE(optimize("(+ x 1)"s));
+    ASSERT_FALSE(optimize("(cons 1 2)"s))
+        << "Only pure builtins fold"sv;
+    ASSERT_FALSE(optimize("(/ 1 0)"s))
+        << "Errors are left for when the form runs"sv;
+    ASSERT_FALSE(optimize("(lambda (+) (+ 2 3))"s))
+        << "A parameter hides the builtin"sv;
+    ASSERT_FALSE(optimize("(lambda (x) (if x (define pi 3)) (* 2 pi))"s))
+        << "So does a define in the body"sv;
+    ASSERT_TRUE(optimize("(lambda (x) ((lambda (pi) pi) 1) (* 2 pi))"s))
+        << "A lambda further in only hides it in there"sv;
+
+    env.insert(Symbol{"e"}, Number{1.0});
+    ASSERT_EQ(guard & Optimizer::hidden(env), 0u)
+        << "Hiding a builtin the form doesn't use leaves it be"sv;
+    env.insert(Symbol{"pi"}, Number{3.0});
+    ASSERT_NE(Optimizer::guard(folded[2]) & Optimizer::hidden(env), 0u);
+    ASSERT_NE(guard & Optimizer::hidden(env), 0u);
+    ASSERT_FALSE(optimize("(* 2 pi)"s))
+        << "A builtin that's been defined over isn't folded"sv;
+
+    // Defining over a builtin after the fact, or earlier in the same
+    // program, has to be seen by whatever got folded before
+    for (auto engine : {Interpreter::Engine::Bytecode, Interpreter::Engine::TreeWalker}) {
+        Interpreter interp{engine};
+        interp.eval("(define half-turn (lambda (x) (* x 2 pi (/ 1 360))))"s);
+        interp.eval("(define three (lambda () (+ 1 2)))"s);
+        ASSERT_DOUBLE_EQ(std::get<Number>(interp.eval("(half-turn 180)"s)).value(), std::numbers::pi);
+        ASSERT_EQ(print(interp.eval("(three)"s)), "3"s);
+
+        auto code = interp.compile("(* 2 3)"s);
+        ASSERT_EQ(print(interp.run(code)), "6"s);
+
+        interp.eval("(define pi 3)"s);
+        interp.eval("(define + -)"s);
+        interp.eval("(define * +)"s);
+        ASSERT_DOUBLE_EQ(std::get<Number>(interp.eval("(half-turn 180)"s)).value(), -185 - 1.0 / 360)
+            << "A folded form must not outlive the builtins it used"sv;
+        ASSERT_EQ(print(interp.eval("(three)"s)), "-3"s);
+        ASSERT_EQ(print(interp.run(code)), "-5"s)
+            << "Compiled code must check its folds again"sv;
+
+        Interpreter fresh{engine};
+        ASSERT_EQ(print(fresh.eval_all("(define e 1) (+ e 1)"s)), "2"s);
+        ASSERT_THROW(fresh.eval("(if (< 1 2) (/ 1 0) 0)"s), std::runtime_error);
+    }
+}
+
+TEST(InterpreterTest, BinaryOpTest) {
+    auto print = [] (Cell const & cell) {
+        std::ostringstream ostr{};
+        ostr << cell;
+        return ostr.str();
+    };
+
+    // Whenever a fast version has an answer it has to be the very
+    // same bits the builtin comes up with
+    Heap heap{};
+    auto const big = Value::from_integer(*BigInt::from_string("100000000000000000000"sv), heap);
+    std::vector<Value> const values{
+        Value::from_fixnum(0), Value::from_fixnum(3), Value::from_fixnum(-7),
+        Value::from_fixnum(Value::max_fixnum), Value::from_fixnum(Value::min_fixnum),
+        Number{0.0}, Number{-0.0}, Number{2.5}, Number{-1e300},
+        Number{std::numeric_limits<double>::infinity()}, big, Bool{true},
+    };
+
+    using Fast = std::optional<Value> (*)(Value, Value) noexcept;
+    std::vector<std::tuple<Native, Fast>> const ops{
+        {add, fast::add}, {sub, fast::sub}, {mul, fast::mul}, {div, fast::div},
+        {less, fast::less}, {less_equal, fast::less_equal},
+        {greater, fast::greater}, {greater_equal, fast::greater_equal},
+    };
+
+    for (auto [native, fast] : ops) {
+        for (auto lhs : values) {
+            for (auto rhs : values) {
+                auto const args = std::vector<Value>{lhs, rhs};
+                if (auto result = fast(lhs, rhs)) {
+                    ASSERT_EQ(result->bits(), native(args, heap).bits())
+                        << "A fast path must agree with its builtin"sv;
+                }
+            }
+        }
+    }
+
+    ASSERT_TRUE(fast::add(Value::from_fixnum(1), Number{2.5}));
+    ASSERT_TRUE(fast::less(Number{-0.0}, Value::from_fixnum(0)));
+    ASSERT_FALSE(fast::add(Value::from_fixnum(Value::max_fixnum), Value::from_fixnum(1)))
+        << "Overflowing a fixnum is the builtin's job"sv;
+    ASSERT_FALSE(fast::mul(big, Value::from_fixnum(2)));
+    ASSERT_FALSE(fast::div(Value::from_fixnum(1), Number{0.0}))
+        << "So is complaining about a zero division"sv;
+    ASSERT_FALSE(fast::less(Bool{true}, Value::from_fixnum(1)));
+
+    // The instructions in the VM, with the tree walker to check them
+    // against. Arguments that come from parameters so nothing folds.
+    auto const defs =
+        "(define add (lambda (a b) (+ a b))) (define sub (lambda (a b) (- a b)))"
+        "(define mul (lambda (a b) (* a b))) (define div (lambda (a b) (/ a b)))"
+        "(define lt (lambda (a b) (< a b))) (define ge (lambda (a b) (>= a b)))"s;
+    std::vector<std::string> const programs{
+        "(add 1 2)"s, "(add -0.0 -0.0)"s, "(sub 3 0.5)"s, "(sub -0.0 0)"s,
+        "(mul 4194304 4194304)"s, "(mul 70368744177663 70368744177663)"s,
+        "(add 70368744177663 1)"s, "(sub 100000000000000000000 1)"s,
+        "(div 1 4)"s, "(lt 1 1.5)"s, "(lt 2 100000000000000000000)"s, "(ge 2 2.0)"s,
+        "(div 1 0)"s, "(add #t 1)"s, "(lt (list 1) 2)"s,
+    };
+
+    Interpreter vm{Interpreter::Engine::Bytecode};
+    Interpreter walker{Interpreter::Engine::TreeWalker};
+    vm.eval_all(defs);
+    walker.eval_all(defs);
+    auto run = [&print] (Interpreter & interp, std::string const & src) {
+        try {
+            return print(interp.eval(src));
+        }
+        catch (std::runtime_error const & err) {
+            return "error: "s + err.what();
+        }
+    };
+
+    for (auto const & src : programs) {
+        ASSERT_EQ(run(vm, src), run(walker, src))
+            << "The engines disagree on "sv << src;
+    }
+
+    std::ostringstream code{};
+    code << vm.compile("(< x 1)"s);
+    ASSERT_NE(code.str().find("Less"s), std::string::npos)
+        << "A call of < with two arguments gets an instruction of its own"sv;
+
+    for (auto engine : {Interpreter::Engine::Bytecode, Interpreter::Engine::TreeWalker}) {
+        Interpreter interp{engine};
+        interp.eval_all(defs);
+        ASSERT_EQ(print(interp.eval("((lambda (+ a b) (+ a b)) * 3 4)"s)), "12"s)
+            << "A parameter called + isn't the builtin"sv;
+
+        // Redefined after the calls ran the fast way, sub's is a tail call
+        ASSERT_EQ(print(interp.eval("(add 3 4)"s)), "7"s);
+        ASSERT_EQ(print(interp.eval("(sub 3 4)"s)), "-7"s);
+        interp.eval("(define + *)"s);
+        interp.eval("(define - (lambda (x y) (list y x)))"s);
+        ASSERT_EQ(print(interp.eval("(add 3 4)"s)), "12"s)
+            << "A redefined builtin must be called"sv;
+        ASSERT_EQ(print(interp.eval("(car (sub 3 4))"s)), "4"s);
+    }
+}
+
+TEST(InterpreterTest, NoCopyTest) {
+    auto setup = "(define build (lambda (n acc) (if (< n 1) acc (build (+ n -1) (cons n acc)))))"
+                 "(define xs (build 1000 ())) (define x 5) (define y 0)"
+                 "(define loop (lambda (n acc) (if (< n 1) acc (loop (+ n -1) (+ acc 1)))))"s;
+
+    // Looking up, passing and rebinding a list is a Value's worth
+    // of work whatever its length, nothing gets allocated at all
+    Parser parser{};
+    auto forms = parser.parse_all("(length xs) (define y xs) (if (< x 1) (car xs) (+ x 1))"
+                                  "(eqv? (cdr xs) (cdr y)) (car (cdr (cdr xs)))"s);
+    for (auto engine : {Interpreter::Engine::Bytecode, Interpreter::Engine::TreeWalker}) {
+        Interpreter interp{engine};
+        interp.eval_all(setup);
+        interp.collect();
+
+        if (engine == Interpreter::Engine::TreeWalker) {
+            interp.eval_all(forms);
+            ASSERT_EQ(count_allocations(interp, [&] { interp.eval_all(forms); }), 0u)
+                << "Evaluating forms that make nothing must not allocate"sv;
+        }
+
+        else {
+            auto code = interp.compile("(begin (define y xs) (if (< x 1) (car xs) (length y)))"s);
+            auto loop = interp.compile("(loop 1000 0)"s);
+            interp.run(code);
+            interp.run(loop);
+            ASSERT_EQ(count_allocations(interp, [&] { interp.run(code); }), 0u)
+                << "Running compiled code that makes nothing must not allocate"sv;
+            ASSERT_EQ(count_allocations(interp, [&] { interp.run(loop); }), 0u)
+                << "A tail call loop on the VM must not allocate"sv;
+        }
+    }
+
+    // An inner lambda costs the same however big its body is, the
+    // body was copied once along with the outer one
+    auto small = "(define small (lambda (n) (lambda (x) (+ x n))))"s;
+    auto big = "(define big (lambda (n) (lambda (x) (+ x n"s;
+    for (auto i = 0; i < 200; ++i) {
+        big += " (+ 1 (* 2 (- 3 4)))"s;
+    }
+
+    big += "))))"s;
+    for (auto engine : {Interpreter::Engine::Bytecode, Interpreter::Engine::TreeWalker}) {
+        Interpreter interp{engine};
+        interp.eval_all(small + big);
+        auto call_small = parser.parse("(small 1)"s);
+        auto call_big = parser.parse("(big 1)"s);
+        interp.eval_form(call_small);
+        interp.eval_form(call_big);
+        interp.collect();
+
+        auto const small_count = count_allocations(interp, [&] { interp.eval_form(call_small); });
+        auto const big_count = count_allocations(interp, [&] { interp.eval_form(call_big); });
+        ASSERT_EQ(small_count, big_count)
+            << "Evaluating a lambda must not copy its body"sv;
+    }
+}
+
+TEST(InterpreterTest, GarbageCollectionTest) {
+    // Every call makes a scope, the define sees to that
+    auto count = "(define count (lambda (n) (define m (+ n -1)) (if (< m 0) n (count m))))"s;
+    for (auto engine : {Interpreter::Engine::Bytecode, Interpreter::Engine::TreeWalker}) {
+        Interpreter interp{engine};
+        interp.eval(count);
+        ASSERT_EQ(std::get<Number>(interp.eval("(count 100000)"s)).value(), 0.0);
+
+        auto stats = interp.heap_stats();
+        ASSERT_GT(stats.collections, 0u)
+            << "A long loop must have collected along the way"sv;
+        ASSERT_LT(stats.objects, 2 * stats.threshold)
+            << "The scopes of finished calls must not pile up"sv;
+
+        // A closure bound in the scope it captured is a cycle,
+        // nothing but the collector ever frees it
+        interp.eval("(define cycle ((lambda () (define self (lambda () self)) self)))"s);
+        interp.eval("(define count 0)"s);
+        interp.collect();
+        ASSERT_GT(interp.heap_stats().objects, 0u);
+        interp.eval("(define cycle 0)"s);
+        interp.collect();
+        ASSERT_EQ(interp.heap_stats().objects, 0u)
+            << "Unreachable closures and scopes must be collected"sv;
+
+        // A Lambda handed out pins its closure and whatever it needs
+        auto lambda = interp.eval("((lambda (n) (lambda (x) (* x n))) 3)"s);
+        interp.collect();
+        ASSERT_GT(interp.heap_stats().objects, 0u)
+            << "A Lambda held outside must survive a collection"sv;
+        lambda = Nil{};
+        interp.collect();
+        ASSERT_EQ(interp.heap_stats().objects, 0u);
+    }
+
+    // Moving another Heap over one has to leave its pinned Objects
+    // behind as orphans, same as destroying it does
+    Heap heap{};
+    auto const big = Value::from_integer(*BigInt::from_string("100000000000000000000"sv), heap);
+    pin(big);
+    heap = Heap{};
+    std::ostringstream ostr{};
+    ostr << big.to_cell();
+    ASSERT_EQ(ostr.str(), "100000000000000000000"s)
+        << "A pinned Object must outlive its Heap being moved over"sv;
+    unpin(big);
+}
+
 int main(int argc, char ** argv) {
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
@@ -156,6 +156,70 @@ TEST(LexerTest, LexParensTest) {
         << "Lexer failed to recognize '" << txt << "' as a right paren"sv;
 }
 
+TEST(LexerTest, TokensViewTheSourceTest) {
+    auto txt = "(define answer 42)"s;
+    Lexer lexer{txt};
+    auto token = lexer.next();
+    while (token != Token::Type::Eof) {
+        if (token == Token::Type::Id || token == Token::Type::Num) {
+            auto view = token.strview();
+            ASSERT_TRUE(view.data() >= txt.data() && view.data() + view.size() <= txt.data() + txt.size())
+                << "Token '"sv << view << "' must point into the source"sv;
+        }
+
+        token = lexer.next();
+    }
+}
+
+TEST(LexerTest, LongIdClassificationTest) {
+    // Long enough to go through the vectorized skipping, every
+    // byte value gets a turn at ending the identifier
+    auto is_subsequent = [] (unsigned char c) {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+               (c >= '0' && c <= '9') ||
+               "!$%&*/:<=>?~_^.+-"sv.find(static_cast<char>(c)) != std::string_view::npos;
+    };
+
+    auto const prefix = "a-long-identifier-that-spans-more-than-one-vector/+.!?<=>"s;
+    for (auto c = 1; c < 256; ++c) {
+        auto txt = prefix;
+        txt += static_cast<char>(c);
+        txt += "xyz"s;
+        Lexer lexer{txt};
+        auto token = lexer.next();
+        auto expected = is_subsequent(static_cast<unsigned char>(c)) ? txt : prefix;
+        ASSERT_EQ(token.strview(), expected)
+            << "Lexer split an identifier wrong on character "sv << c;
+
+        ASSERT_EQ(lexer.col(), static_cast<int>(expected.size()) + 1)
+            << "Lexer lost track of the column on character "sv << c;
+    }
+}
+
+TEST(LexerTest, WSAndCommentsTest) {
+    auto txt = "  ; one\n\t; two\n\n      \n   (   ; three\n  foo"s;
+    Lexer lexer{txt};
+    auto token = lexer.next();
+    ASSERT_EQ(token.type(), Token::Type::LPar)
+        << "Lexer failed to skip whitespace mixed with comments"sv;
+
+    ASSERT_EQ(lexer.row(), 5)
+        << "Lexer lost track of the row"sv;
+
+    ASSERT_EQ(lexer.col(), 5)
+        << "Lexer lost track of the column"sv;
+
+    token = lexer.next();
+    ASSERT_EQ(token.strview(), "foo"sv)
+        << "Lexer failed to skip a trailing comment"sv;
+
+    ASSERT_EQ(lexer.row(), 6)
+        << "Lexer lost track of the row"sv;
+
+    ASSERT_EQ(lexer.col(), 6)
+        << "Lexer lost track of the column"sv;
+}
+
 TEST(LexerTest, LexCommentTest) {
     auto txt = ";This is just like ws\n1234"s;
     Lexer lexer{txt};
@@ -1,5 +1,17 @@
+#include "bigint.hh"
+#include "form_reader.hh"
+#include "mapped_file.hh"
+#include "parallel_parser.hh"
 #include "parser.hh"
 #include "gtest/gtest.h"
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
 #include <string>
 #include <tuple>
 #include <vector>
@@ -31,16 +43,17 @@ TEST(ParserTest, BoolCellConstruction) {
     };
 
     for (auto [str, val] : booleans) {
-        Bool boolean{str};
+        Parser parser{};
+        auto boolean = std::get<Bool>(parser.parse(str));
         ASSERT_EQ(boolean.value(), val)
-            << "Bool(str) constructed '"sv << boolean.value()
+            << "The parser made '"sv << boolean.value()
             << "' from '"sv << str << "'"sv;
     }
 }
 
 TEST(ParserTest, CellIsAtomTest) {
     auto cells = std::vector<Cell>{
-        Number{1.24}, Symbol{"pi"s}, Bool{"#t"s} 
+        Number{1.24}, Symbol{"pi"s}, Bool{true}
     };
 
     for (auto const & cell : cells) {
@@ -58,6 +71,29 @@ TEST(ParserTest, CellIsAtomTest) {
     }
 }
 
+TEST(ParserTest, SymbolInterningTest) {
+    auto foo = Symbol{"foo"s};
+    auto loud_foo = Symbol{"FOO"s};
+    auto bar = Symbol{"bar"s};
+    ASSERT_EQ(foo.id(), loud_foo.id())
+        << "Symbols must be interned without regard to case"sv;
+
+    ASSERT_EQ(foo, loud_foo)
+        << "Symbols with the same id must compare equal"sv;
+
+    ASSERT_NE(foo, bar)
+        << "Different names must get different ids"sv;
+
+    ASSERT_TRUE(Symbol{"DEFINE"s}.is_keyword())
+        << "define must be interned as a keyword"sv;
+
+    ASSERT_EQ(Symbol{"If"s}.id(), Symbol::If)
+        << "if must have its reserved id"sv;
+
+    ASSERT_FALSE(bar.is_keyword())
+        << "bar is not a keyword"sv;
+}
+
 TEST(ParserTest, ParseEmptyStrTest) {
     Parser parser{};
     auto src = ""s;
@@ -74,6 +110,76 @@ TEST(ParserTest, ParseNumberTest) {
         << "Parser failed to parse a simple number"sv;
 }
 
+TEST(ParserTest, ParseNumberValuesTest) {
+    auto numbers = std::vector{
+        std::pair{"0123"s, 123.0}, std::pair{"+0123"s, 123.0},
+        std::pair{"-0123"s, -123.0}, std::pair{"0.5678"s, 0.5678},
+        std::pair{"+0.5678"s, 0.5678}, std::pair{"-0.5678"s, -0.5678},
+        std::pair{".90123"s, .90123}, std::pair{"+.90123"s, .90123},
+        std::pair{"-.90123"s, -.90123}, std::pair{"42."s, 42.0}
+    };
+
+    Parser parser{};
+    for (auto const & [src, truth] : numbers) {
+        auto const & res = parser.parse(src);
+        ASSERT_TRUE(res.is_number())
+            << "Parser failed to parse '"sv << src << "' as a number"sv;
+
+        ASSERT_EQ(std::get<Number>(res).value(), truth)
+            << "Parser got the wrong value for '"sv << src << "'"sv;
+    }
+
+    ASSERT_THROW(parser.parse("..5"s), std::runtime_error)
+        << "Parser must reject malformed numbers"sv;
+}
+
+TEST(ParserTest, ParseExactNumberTest) {
+    Parser parser{};
+    for (auto const & src : {"42"s, "+42"s, "-42"s, "9007199254740993"s}) {
+        auto const & res = parser.parse(src);
+        ASSERT_TRUE(std::get<Number>(res).is_exact())
+            << "Parser must read '"sv << src << "' as an exact integer"sv;
+    }
+
+    ASSERT_EQ(std::get<Number>(parser.parse("9007199254740993"s)).exact(), 9007199254740993)
+        << "Exact integers must not go through a double"sv;
+
+    auto big = std::get<Number>(parser.parse("-99999999999999999999"s));
+    ASSERT_TRUE(big.is_big())
+        << "Integers that don't fit in 64 bits must be bignums"sv;
+    ASSERT_EQ(big.big().to_string(), "-99999999999999999999"s);
+
+    for (auto const & src : {"42."s, "4.2"s, "-0.25"s}) {
+        ASSERT_FALSE(std::get<Number>(parser.parse(src)).is_exact())
+            << "Parser must read '"sv << src << "' as a double"sv;
+    }
+}
+
+TEST(ParserTest, PrintNumberTest) {
+    auto numbers = std::vector{
+        0.0, -0.0, 1.0, 42.0, -7.5, 3.14159265358979, 2.718281828459045,
+        1e21, 1.5e-7, 123456789.0, 0.1 + 0.2,
+        std::numeric_limits<double>::infinity(),
+        std::numeric_limits<double>::quiet_NaN()
+    };
+
+    for (auto num : numbers) {
+        for (auto precision : {6, 0, 17}) {
+            std::ostringstream expected{}, actual{};
+            expected << std::setprecision(precision) << num;
+            actual << std::setprecision(precision) << Number{num};
+            ASSERT_EQ(expected.str(), actual.str())
+                << "Number must print like a double"sv;
+        }
+    }
+
+    std::ostringstream expected{}, actual{};
+    expected << std::fixed << std::setw(12) << 3.5;
+    actual << std::fixed << std::setw(12) << Number{3.5};
+    ASSERT_EQ(expected.str(), actual.str())
+        << "Number must honor the stream's formatting"sv;
+}
+
 TEST(ParserTest, ParseSymbolTest) {
     Parser parser{};
     auto src = "pi"s;
@@ -101,6 +207,255 @@ TEST(ParserTest, ParseListTest) {
         << "Parser failed to parse the list's elements"sv;
 }
 
+TEST(ParserTest, ArenaResetTest) {
+    Arena arena{64};
+    for (auto i = 0; i < 100; ++i) {
+        auto ptr = arena.allocate(24, 8);
+        ASSERT_EQ(reinterpret_cast<std::uintptr_t>(ptr) % 8, 0)
+            << "Arena handed out misaligned memory"sv;
+    }
+
+    ASSERT_EQ(arena.used(), 2400)
+        << "Arena failed to account for its allocations"sv;
+
+    auto capacity = arena.capacity();
+    arena.reset();
+    ASSERT_EQ(arena.used(), 0)
+        << "Arena reset must give everything back"sv;
+
+    ASSERT_GT(arena.capacity(), 0)
+        << "Arena reset must hang on to its biggest block"sv;
+
+    ASSERT_LE(arena.capacity(), capacity)
+        << "Arena reset must not grow the arena"sv;
+}
+
+TEST(ParserTest, ParseTreeCopyOutlivesParseTest) {
+    Parser parser{};
+    Cell kept = parser.parse("(define xs (1 (2 #t) foo))"s);
+    parser.parse("(completely (different (tree)))"s);
+    std::ostringstream ostr{};
+    ostr << kept;
+    ASSERT_EQ(ostr.str(), "(define,xs,(1,(2,#t),foo))"s)
+        << "A copy of the parse tree must survive the next parse"sv;
+}
+
+TEST(ParserTest, ParseAllTest) {
+    Parser parser{};
+    auto const & forms = parser.parse_all(
+        "; a small program\n(define x 10)\n  x #t\n(+ x (* 2 3)) ; done\n"s
+    );
+
+    std::ostringstream ostr{};
+    for (auto const & form : forms) {
+        ostr << form << ' ';
+    }
+
+    ASSERT_EQ(ostr.str(), "(define,x,10) x #t (+,x,(*,2,3)) "s)
+        << "Parser failed to parse every top level form in order"sv;
+
+    ASSERT_TRUE(parser.parse_all("  ; nothing but a comment\n"s).empty())
+        << "A source without forms must parse to no forms"sv;
+
+    ASSERT_THROW(parser.parse_all("(+ 1 2) (foo"s), std::runtime_error)
+        << "An unclosed form must be reported"sv;
+
+    ASSERT_THROW(parser.parse_all("(+ 1 2))"s), std::runtime_error)
+        << "A wayward ')' between forms must be reported"sv;
+}
+
+TEST(ParserTest, ParallelParseAllTest) {
+    // Lots of small chunks on purpose, with parens hiding in
+    // comments and forms spread over several lines
+    std::string src{};
+    for (auto i = 0; i < 200; ++i) {
+        src += "; (not a form\n(define x"s + std::to_string(i) + " (+ 1\n   "s
+            + std::to_string(i) + "))  x ; trailing ))\n#t "s;
+    }
+
+    Parser serial{};
+    ParallelParser parallel{4, 64};
+    std::ostringstream expected{}, actual{};
+    for (auto const & form : serial.parse_all(src)) {
+        expected << form << ' ';
+    }
+
+    for (auto const & form : parallel.parse_all(src)) {
+        actual << form << ' ';
+    }
+
+    ASSERT_EQ(actual.str(), expected.str())
+        << "Parallel parser must give the same forms in the same order"sv;
+
+    // The error message carries the row and column, it has to be
+    // the same one the serial parser reports
+    for (auto bad : {"(define y @)\n"s, "(oops))\n"s, "(unclosed\n"s}) {
+        auto broken = src + bad + src;
+        std::string serial_error{}, parallel_error{};
+        try { serial.parse_all(broken); }
+        catch (std::runtime_error const & e) { serial_error = e.what(); }
+        try { parallel.parse_all(broken); }
+        catch (std::runtime_error const & e) { parallel_error = e.what(); }
+
+        ASSERT_FALSE(serial_error.empty());
+        ASSERT_EQ(parallel_error, serial_error)
+            << "Parallel parser must report the first error in the source"sv;
+    }
+}
+
+TEST(ParserTest, FormReaderTest) {
+    std::string src{};
+    for (auto i = 0; i < 100; ++i) {
+        src += "(define x"s + std::to_string(i) + " ; (nope\n  (+ 1 "s
+            + std::to_string(i) + ")) y"s + std::to_string(i) + " (a)(b)\n"s;
+    }
+
+    Parser parser{};
+    std::ostringstream expected{};
+    for (auto const & form : parser.parse_all(src)) {
+        expected << form << ' ';
+    }
+
+    auto read_all = [] (FormReader & reader) {
+        std::ostringstream ostr{};
+        while (auto form = reader.next()) {
+            ostr << *form << ' ';
+        }
+
+        return ostr.str();
+    };
+
+    // Tiny windows so that lots of forms straddle a refill
+    for (auto window : {std::size_t{1}, std::size_t{7}, std::size_t{4096}}) {
+        FormReader from_text{src, window};
+        ASSERT_EQ(read_all(from_text), expected.str())
+            << "FormReader over text lost or reordered forms"sv;
+
+        std::istringstream in{src};
+        FormReader from_stream{in, window};
+        ASSERT_EQ(read_all(from_stream), expected.str())
+            << "FormReader over a stream lost or reordered forms"sv;
+    }
+
+    auto path = std::filesystem::temp_directory_path() / "esquema_form_reader_test.scm";
+    std::ofstream{path} << src;
+    {
+        MappedFile file{path.string()};
+        FormReader from_file{file, 64};
+        ASSERT_EQ(read_all(from_file), expected.str())
+            << "FormReader over a mapped file lost or reordered forms"sv;
+    }
+
+    std::filesystem::remove(path);
+    ASSERT_THROW(MappedFile{path.string()}, std::runtime_error)
+        << "A missing file must be reported"sv;
+
+    // Errors point at the same place the Parser would
+    auto broken = src + "\n  (foo @)\n"s;
+    std::string parser_error{}, reader_error{};
+    try { parser.parse_all(broken); }
+    catch (std::runtime_error const & e) { parser_error = e.what(); }
+
+    std::istringstream in{broken};
+    FormReader reader{in, 16};
+    try { read_all(reader); }
+    catch (std::runtime_error const & e) { reader_error = e.what(); }
+
+    ASSERT_FALSE(parser_error.empty());
+    ASSERT_EQ(reader_error, parser_error)
+        << "FormReader must report errors where they are in the source"sv;
+}
+
+TEST(ParserTest, DeepNestingTest) {
+    // Far deeper than a recursive parser could go on a default stack
+    auto const depth = 200000;
+    auto src = std::string(depth, '(') + "42"s + std::string(depth, ')');
+    Parser parser{};
+    auto const * cell = &parser.parse(src);
+    for (auto i = 0; i < depth; ++i) {
+        ASSERT_TRUE(cell->is_list())
+            << "Parser lost a level of nesting"sv;
+        ASSERT_EQ(std::get<List>(*cell).size(), 1);
+        cell = &std::get<List>(*cell).front();
+    }
+
+    ASSERT_TRUE(cell->is_number())
+        << "Parser lost the innermost atom"sv;
+
+    Parser shallow{16 * sizeof(std::size_t)};
+    ASSERT_NO_THROW(shallow.parse(std::string(16, '(') + std::string(16, ')')));
+    ASSERT_THROW(shallow.parse(std::string(17, '(') + std::string(17, ')')), std::runtime_error)
+        << "Parser must stop at its nesting limit"sv;
+
+    // The parser is good to go again after running out of room
+    ASSERT_NO_THROW(shallow.parse("(+ 1 (* 2 3))"s));
+}
+
+TEST(ParserTest, IncrementalParseTest) {
+    auto const src = "(define x ; a (comment\n  (+ 10\n 25.5))\n"
+        "x #t (begin\n(foo) bar) ; the end\nbaz"s;
+
+    Parser whole{};
+    std::ostringstream expected{};
+    for (auto const & form : whole.parse_all(src)) {
+        expected << form << ' ';
+    }
+
+    // Every way of cutting the source in pieces of the same size,
+    // tokens and comments get cut in half all over the place
+    Parser parser{};
+    for (auto size = std::size_t{1}; size <= src.size(); ++size) {
+        std::ostringstream actual{};
+        for (auto at = std::size_t{0}; at < src.size(); at += size) {
+            for (auto const & form : parser.feed(std::string_view(src).substr(at, size))) {
+                actual << form << ' ';
+            }
+        }
+
+        for (auto const & form : parser.finish()) {
+            actual << form << ' ';
+        }
+
+        ASSERT_EQ(actual.str(), expected.str())
+            << "Incremental parse went wrong with pieces of "sv << size;
+    }
+
+    ASSERT_TRUE(parser.feed("(+ 1\n"s).empty());
+    ASSERT_TRUE(parser.incomplete())
+        << "Parser must know a list is still open"sv;
+
+    auto const & forms = parser.feed("2)\n"s);
+    ASSERT_EQ(forms.size(), 1);
+    ASSERT_FALSE(parser.incomplete());
+
+    parser.feed("(unfinished (business"s);
+    ASSERT_THROW(parser.finish(), std::runtime_error)
+        << "An open list at the end of the input must be reported"sv;
+    ASSERT_FALSE(parser.incomplete())
+        << "An error must throw the partial form away"sv;
+}
+
+TEST(ParserTest, IncrementalErrorPositionTest) {
+    auto const src = "(a b)\n  (c\n   @)"s;
+    std::string whole_error{}, fed_error{};
+    try { Parser{}.parse_all(src); }
+    catch (std::runtime_error const & e) { whole_error = e.what(); }
+
+    Parser parser{};
+    try {
+        for (auto c : src) {
+            parser.feed(std::string_view(&c, 1));
+        }
+
+        parser.finish();
+    }
+    catch (std::runtime_error const & e) { fed_error = e.what(); }
+
+    ASSERT_FALSE(whole_error.empty());
+    ASSERT_EQ(fed_error, whole_error)
+        << "Incremental parser lost track of the row and column"sv;
+}
+
 int main(int argc, char ** argv) {
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();